@@ -1,4 +1,5 @@
 #include "assembler.h"
+#include "dataflow.h"
 #include <cassert>
 
 int Assembler::make_label() { labels.emplace_back(); return (int)labels.size() - 1; }
@@ -47,126 +48,245 @@ void Assembler::run_optimizations(int level, int max_iters) {
         changed = false;
         if (level >= 1) changed |= pass_peep_hole();
         if (level >= 1) changed |= pass_constant_fold_and_propagate();
+        if (level >= 1) changed |= pass_copy_propagate();
+        if (level >= 1) changed |= pass_dead_code();
+        if (level >= 1) changed |= pass_specialize_types();
+        if (level >= 2) changed |= pass_scalar_replace();
+        if (level >= 2) changed |= pass_evaluate_pure_calls();
+        if (level >= 2) changed |= pass_loop_invariant_motion();
+        if (level >= 2) changed |= pass_strength_reduce();
+        if (level >= 2) changed |= pass_reduce_division();
         iter++;
     } while (changed && iter < max_iters);
+    if (level >= 1) pass_elide_refcounts();
+}
+
+// can "op t, ..." write straight into x instead of t
+static bool can_retarget(const Instr& ins, int x) {
+    if (!op_is_pure(ins.op) && !op_allocates(ins.op)) return false;
+    // OP_CONCAT_N reads the registers right after a
+    if (call_arg_count(ins) > 0) return false;
+    if (!op_reads_heap(ins.op)) return true;
+    // the container may be released by the store into its own register
+    unsigned regs = reg_operands(ins.op);
+    return !((regs & OPND_B) && ins.b == x) && !((regs & OPND_C) && ins.c == x);
 }
 
 bool Assembler::pass_peep_hole() {
+    ControlFlow cfg; cfg.build(*this);
+    Liveness live; live.compute(code, cfg);
     bool changed = false;
-    std::vector<int> removed(code.size(), 0);
-    for (size_t i = 0; i + 1 < code.size(); ++i) {
-        auto &ins = code[i];
-        auto &insn = code[i+1];
-        if (ins.op == OP_CONST && insn.op == OP_MOVE && insn.b == ins.a) {
-            insn.op = OP_CONST;
-            insn.b = ins.b;
-            insn.c = 0;
-            removed[i] = 1; changed = true;
+    std::vector<int> removed;
+    std::vector<RegSet> after;
+    for (int b = 0; b < (int)cfg.start.size(); ++b) {
+        int s = cfg.start[b], e = cfg.end(b);
+        live.live_after(code, cfg, b, after);
+        for (int i = s; i < e; ++i) {
+            Instr &ins = code[i];
+            if (ins.op == OP_MOVE && ins.a == ins.b) { removed.push_back(i); changed = true; continue; }
+            if (ins.op == OP_JMP && ins.b == i + 1) { removed.push_back(i); changed = true; continue; }
+            // "op t, ...; move x, t" with t dead afterwards computes straight into x
+            if (i + 1 < e && op_writes_a(ins.op) && code[i+1].op == OP_MOVE && code[i+1].b == ins.a &&
+                code[i+1].a != ins.a && can_retarget(ins, code[i+1].a) && !after[i + 1 - s].test(ins.a)) {
+                ins.a = code[i+1].a;
+                removed.push_back(i + 1); changed = true;
+                ++i;
+            }
         }
-        if (ins.op == OP_MOVE && ins.a == ins.b) { removed[i] = 1; changed = true; }
-    }
-    if (changed) {
-        std::vector<int> rem_idx;
-        for (size_t i = 0; i < removed.size(); ++i) if (removed[i]) rem_idx.push_back((int)i);
-        compact_and_rewrite_labels(rem_idx);
     }
+    if (changed) compact_and_rewrite_labels(removed);
     return changed;
 }
 
 bool Assembler::pass_constant_fold_and_propagate() {
+    ControlFlow cfg; cfg.build(*this);
+    ReachingConsts rc; rc.compute(code, cfg, max_register(code, 0, (int)code.size()) + 1);
     bool changed = false;
-    std::vector<int> removed(code.size(), 0);
-
-    for (size_t i = 0; i < code.size(); ++i) {
-        Instr &ins = code[i];
-        if (ins.op == OP_ADD || ins.op == OP_SUB || ins.op == OP_MUL || ins.op == OP_DIV) {
-            if (ins.a >= 0 && ins.b >= 0) {
-                if (i >= 2) {
-                    Instr &i1 = code[i-2];
-                    Instr &i2 = code[i-1];
-                    if (i1.op == OP_CONST && i2.op == OP_CONST) {
-                        if (i1.a == ins.a && i2.a == ins.b) {
-                            Value v1 = constants[i1.b];
-                            Value v2 = constants[i2.b];
-                            if (v1.is_num() && v2.is_num()) {
-                                long long n1 = v1.as_intscaled();
-                                long long n2 = v2.as_intscaled();
-                                long long result = 0;
-                                bool ok = true;
-                                switch (ins.op) {
-                                    case OP_ADD: result = n1 + n2; break;
-                                    case OP_SUB: result = n1 - n2; break;
-                                    case OP_MUL: result = n1 * n2; break;
-                                    case OP_DIV: if (n2 == 0) ok = false; else result = n1 / n2; break;
-                                    default: ok = false; break;
-                                }
-                                if (ok) {
-                                    Value newv = Value::make_intscaled(result);
-                                    int new_const = add_constant(newv);
-                                    ins.op = OP_CONST;
-                                    ins.b = new_const;
-                                    ins.c = 0;
-                                    removed[i-2] = 1; removed[i-1] = 1;
-                                    changed = true;
-                                }
-                            }
-                        }
-                    }
+    std::vector<int> removed;
+
+    for (int b = 0; b < (int)cfg.start.size(); ++b) {
+        std::vector<int> st = rc.in[b];
+        auto known = [&](int r) -> const Value* {
+            return (r >= 0 && r < (int)st.size() && st[r] >= 0) ? &constants[st[r]] : nullptr;
+        };
+        for (int i = cfg.start[b]; i < cfg.end(b); ++i) {
+            Instr &ins = code[i];
+            const Value* v1 = nullptr;
+            const Value* v2 = nullptr;
+            OpCode op = generic_number_op(ins.op);
+            switch (op) {
+                case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_LT: case OP_GT: case OP_EQ: case OP_CONCAT:
+                    v1 = known(ins.b); v2 = known(ins.c);
+                    break;
+                case OP_MOVE:
+                    v1 = known(ins.b);
+                    break;
+                case OP_JMP_FALSE:
+                    v1 = known(ins.a);
+                    break;
+                default:
+                    break;
+            }
+
+            if (ins.op == OP_MOVE && v1) {
+                ins = {OP_CONST, ins.a, st[ins.b], 0, ins.line};
+                changed = true;
+            } else if (ins.op == OP_JMP_FALSE && v1) {
+                bool cond_false = v1->is_bool() ? !v1->as_bool() : v1->is_nil();
+                if (cond_false) ins = {OP_JMP, 0, ins.b, 0, ins.line};
+                else removed.push_back(i);
+                changed = true;
+            } else if (v1 && v2 && op == OP_EQ) {
+                // the VM compares raw values
+                ins = {OP_CONST, ins.a, add_constant(Value::make_bool(v1->raw == v2->raw)), 0, ins.line};
+                changed = true;
+            } else if (v1 && v2 && op == OP_CONCAT) {
+                Value result = Value::make_nil();
+                if (v1->is_obj() && v1->as_obj()->type == OBJ_STRING && v2->is_obj() && v2->as_obj()->type == OBJ_STRING)
+                    result = Value::make_obj(new ObjString(std::string(((ObjString*)v1->as_obj())->view()) + std::string(((ObjString*)v2->as_obj())->view())));
+                ins = {OP_CONST, ins.a, add_constant(result), 0, ins.line};
+                changed = true;
+            } else if (v1 && v2 && v1->is_num() && v2->is_num()) {
+                int64_t n1 = v1->as_intscaled();
+                int64_t n2 = v2->as_intscaled();
+                Value result = Value::make_nil();
+                switch (op) {
+                    case OP_ADD: result = Value::make_intscaled(n1 + n2); break;
+                    case OP_SUB: result = Value::make_intscaled(n1 - n2); break;
+                    case OP_MUL: result = Value::make_intscaled(intscaled_mul(n1, n2)); break;
+                    case OP_DIV: if (n2 != 0) result = Value::make_intscaled(intscaled_div(n1, n2)); break;
+                    case OP_LT: result = Value::make_bool(n1 < n2); break;
+                    case OP_GT: result = Value::make_bool(n1 > n2); break;
+                    default: break;
                 }
+                ins = {OP_CONST, ins.a, add_constant(result), 0, ins.line};
+                changed = true;
             }
+            step_consts(ins, st);
         }
     }
 
-    if (changed) {
-        std::vector<int> rem_idx;
-        for (size_t i = 0; i < removed.size(); ++i) if (removed[i]) rem_idx.push_back((int)i);
-        compact_and_rewrite_labels(rem_idx);
-    }
+    if (changed) compact_and_rewrite_labels(removed);
+    return changed;
+}
 
+bool Assembler::pass_copy_propagate() {
+    ControlFlow cfg; cfg.build(*this);
+    bool changed = false;
+    for (int b = 0; b < (int)cfg.start.size(); ++b) {
+        int e = cfg.end(b);
+        for (int p = cfg.start[b]; p < e; ++p) {
+            if (code[p].op != OP_MOVE || code[p].a == code[p].b) continue;
+            int t = code[p].a, x = code[p].b;
+            // replace reads of t by x until either register is redefined
+            for (int q = p + 1; q < e; ++q) {
+                Instr &ins = code[q];
+                int argc = call_arg_count(ins);
+                if (argc > 0 && t > ins.a && t <= ins.a + argc) break;
+                int d = instr_def(ins);
+                if (d == x && op_reads_heap(ins.op)) break;
+                unsigned regs = reg_operands(ins.op);
+                if ((regs & OPND_A) && !op_writes_a(ins.op) && ins.a == t) { ins.a = x; changed = true; }
+                if ((regs & OPND_B) && ins.b == t) { ins.b = x; changed = true; }
+                if ((regs & OPND_C) && ins.c == t) { ins.c = x; changed = true; }
+                if (d == t || d == x) break;
+                if (op_may_replace_a(ins.op) && (ins.a == t || ins.a == x)) break;
+            }
+        }
+    }
     return changed;
 }
 
-void Assembler::compact_and_rewrite_labels(const std::vector<int>& removed) {
-    if (removed.empty()) return;
-    std::vector<char> rem(code.size(), 0);
-    for (int r : removed) if (r >= 0 && r < (int)rem.size()) rem[r] = 1;
+bool Assembler::pass_dead_code() {
+    ControlFlow cfg; cfg.build(*this);
+    int nb = (int)cfg.start.size();
+    if (nb == 0) return false;
 
-    for (const auto &lab : labels) {
-        if (lab.target_pc >= 0 && lab.target_pc < (int)rem.size()) {
-            rem[lab.target_pc] = 0;
-        }
+    // blocks reachable from the unit entry or from a function entry
+    std::vector<char> reach(nb, 0);
+    std::vector<int> work{0};
+    for (const auto& f : functions) {
+        int pc = labels[f.entry_label].target_pc;
+        if (pc >= 0 && pc < (int)code.size()) work.push_back(cfg.block_of[pc]);
+    }
+    while (!work.empty()) {
+        int b = work.back(); work.pop_back();
+        if (reach[b]) continue;
+        reach[b] = 1;
+        for (int s : cfg.succ[b]) work.push_back(s);
     }
 
-    std::vector<int> remap(code.size(), -1);
-    std::vector<Instr> newcode;
-    newcode.reserve(code.size());
-    for (size_t i = 0; i < code.size(); ++i) {
-        if (!rem[i]) {
-            remap[i] = (int)newcode.size();
-            newcode.push_back(code[i]);
+    Liveness live; live.compute(code, cfg);
+    std::vector<int> removed;
+    std::vector<RegSet> after;
+    for (int b = 0; b < nb; ++b) {
+        int s = cfg.start[b], e = cfg.end(b);
+        if (!reach[b]) {
+            for (int i = s; i < e; ++i) removed.push_back(i);
+            continue;
         }
+        live.live_after(code, cfg, b, after);
+        for (int i = s; i < e; ++i)
+            if (code[i].op == OP_NOP || (op_is_pure(code[i].op) && !after[i - s].test(code[i].a))) removed.push_back(i);
     }
+    if (removed.empty()) return false;
+    compact_and_rewrite_labels(removed);
+    return true;
+}
 
-    for (auto &lab : labels) {
-        std::vector<int> newrefs;
-        for (int idx : lab.refs) {
-            if (idx >= 0 && idx < (int)remap.size() && remap[idx] != -1) newrefs.push_back(remap[idx]);
-        }
-        lab.refs = std::move(newrefs);
+int Assembler::function_register_ceiling(int pc) const {
+    for (const auto& f : functions) {
+        int start = labels[f.entry_label].target_pc;
+        int end = labels[f.end_label].target_pc;
+        if (pc >= start && pc < end) return max_register(code, start, end) + 1;
+    }
+    return -1;
+}
 
-        if (lab.target_pc >= 0 && lab.target_pc < (int)remap.size())
-            lab.target_pc = remap[lab.target_pc];
-        else if (lab.target_pc >= 0) 
-            lab.target_pc = -1;
+void Assembler::compact_and_rewrite_labels(const std::vector<int>& removed) {
+    if (removed.empty()) return;
+    std::vector<char> rem(code.size(), 0);
+    for (int r : removed) if (r >= 0 && r < (int)rem.size()) rem[r] = 1;
+    splice_code(rem, {});
+}
+
+void Assembler::splice_code(const std::vector<char>& removed, const std::vector<std::vector<Instr>>& before,
+                            int loop_first, int loop_last) {
+    int n = (int)code.size();
+    // entry[pc]: where control arriving at pc lands, self[pc]: pc itself (or the next kept instruction)
+    std::vector<int> entry(n + 1), self(n + 1);
+    int pos = 0;
+    for (int i = 0; i < n; ++i) {
+        entry[i] = pos;
+        if (i < (int)before.size()) pos += (int)before[i].size();
+        self[i] = pos;
+        if (!removed[i]) pos++;
     }
+    entry[n] = self[n] = pos;
 
-    for (auto &ins : newcode) {
-        if (ins.op == OP_JMP || ins.op == OP_JMP_FALSE || ins.op == OP_CALL) {
-            int oldb = ins.b;
-            if (oldb >= 0 && oldb < (int)remap.size()) ins.b = remap[oldb];
-            else ins.b = -1;
+    std::vector<Instr> out;
+    out.reserve(pos);
+    for (int i = 0; i < n; ++i) {
+        if (i < (int)before.size()) out.insert(out.end(), before[i].begin(), before[i].end());
+        if (removed[i]) continue;
+        Instr ins = code[i];
+        if (op_has_pc_target(ins.op) && ins.b >= 0 && ins.b <= n) {
+            bool back_edge = !op_calls_pc(ins.op) && i >= loop_first && i <= loop_last;
+            ins.b = back_edge ? self[ins.b] : entry[ins.b];
         }
+        out.push_back(ins);
     }
 
-    code.swap(newcode);
+    code.swap(out);
+    rebind_labels(entry, pos);
+}
+
+void Assembler::rebind_labels(const std::vector<int>& new_pos, int new_size) {
+    int old_size = (int)new_pos.size() - 1;
+    for (auto &lab : labels) {
+        for (int &idx : lab.refs)
+            if (idx >= 0 && idx < old_size) idx = new_pos[idx];
+        if (lab.target_pc >= 0 && lab.target_pc <= old_size) lab.target_pc = new_pos[lab.target_pc];
+        else if (lab.target_pc > old_size) lab.target_pc = new_size;
+    }
 }
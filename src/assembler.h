@@ -1,7 +1,11 @@
 #pragma once
 #include <vector>
+#include <string>
 #include "value.h"
 
+// registers available to a single call frame in the VM
+static constexpr int MAX_FRAME_REGS = 256;
+
 enum OpCode : uint8_t {
     OP_NOP,
     OP_CONST, OP_MOVE, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_LT, OP_GT, OP_EQ,
@@ -9,8 +13,61 @@ enum OpCode : uint8_t {
     OP_TABLE_SET, OP_TABLE_NEW, OP_INDEX,
     OP_STRUCT_NEW, OP_STRUCT_SET, OP_STRUCT_GET,
     OP_LIST_NEW, OP_LIST_PUSH, OP_LIST_GET, OP_LIST_SET, OP_LIST_LEN,
+    OP_DIV_POW2,
+    // typed variants, operands statically known to be numbers / lists / items
+    OP_ADD_NN, OP_SUB_NN, OP_MUL_NN, OP_DIV_NN, OP_LT_NN, OP_GT_NN,
+    OP_LIST_GET_L, OP_FIELD_GET_ITEM,
+    // ownership transfer: the source register is dead afterwards and is left nil
+    OP_MOVE_OWN, OP_CALL_OWN,
+    // copy between registers that provably never hold objects
+    OP_MOVE_S,
+    // exact complement of OP_JMP_FALSE, lets profile-guided layout put the likely side first
+    OP_JMP_TRUE,
+    // OP_CALL to a memo function: a repeated argument list returns the cached result
+    OP_CALL_MEMO,
+    // string + string, and a + b + ... joined in one allocation from registers a+1 .. a+c
+    OP_CONCAT, OP_CONCAT_N,
+    // + - * / over whole lists, element by element, with a list or a number on either side
+    OP_VEC_ADD, OP_VEC_SUB, OP_VEC_MUL, OP_VEC_DIV,
 };
 
+// typed number variant of a generic arithmetic or compare opcode, or op itself
+inline OpCode typed_number_op(OpCode op) {
+    switch (op) {
+        case OP_ADD: return OP_ADD_NN;
+        case OP_SUB: return OP_SUB_NN;
+        case OP_MUL: return OP_MUL_NN;
+        case OP_DIV: return OP_DIV_NN;
+        case OP_LT:  return OP_LT_NN;
+        case OP_GT:  return OP_GT_NN;
+        default:     return op;
+    }
+}
+
+// element-wise list variant of a generic arithmetic opcode, or op itself
+inline OpCode vector_list_op(OpCode op) {
+    switch (op) {
+        case OP_ADD: return OP_VEC_ADD;
+        case OP_SUB: return OP_VEC_SUB;
+        case OP_MUL: return OP_VEC_MUL;
+        case OP_DIV: return OP_VEC_DIV;
+        default:     return op;
+    }
+}
+
+// generic opcode a typed number variant was made from, or op itself
+inline OpCode generic_number_op(OpCode op) {
+    switch (op) {
+        case OP_ADD_NN: return OP_ADD;
+        case OP_SUB_NN: return OP_SUB;
+        case OP_MUL_NN: return OP_MUL;
+        case OP_DIV_NN: return OP_DIV;
+        case OP_LT_NN:  return OP_LT;
+        case OP_GT_NN:  return OP_GT;
+        default:        return op;
+    }
+}
+
 struct Instr {
     OpCode op;
     int a, b, c;
@@ -22,10 +79,120 @@ struct Label {
     std::vector<int> refs;
 };
 
+// user function body: [labels[entry_label].target_pc, labels[end_label].target_pc)
+struct FuncInfo {
+    std::string name;
+    int entry_label = -1;
+    int end_label = -1;
+};
+
+struct OptRemark {
+    std::string pass;
+    int line;
+    std::string msg;
+};
+
+// operand layout helpers shared by the optimization passes
+enum OperandBits : unsigned { OPND_A = 1, OPND_B = 2, OPND_C = 4 };
+
+// which of a/b/c name registers (call argument windows are implicit, see call_arg_count)
+inline unsigned reg_operands(OpCode op) {
+    switch (op) {
+        case OP_CONST: case OP_TABLE_NEW: case OP_LIST_NEW: case OP_STRUCT_NEW:
+        case OP_JMP_FALSE: case OP_JMP_TRUE: case OP_CALL: case OP_CALL_OWN: case OP_CALL_MEMO: case OP_RETURN:
+        case OP_CONCAT_N:
+            return OPND_A;
+        case OP_MOVE: case OP_LIST_PUSH: case OP_LIST_LEN: case OP_CALL_OBJ: case OP_STRUCT_GET:
+        case OP_MOVE_OWN: case OP_MOVE_S:
+        case OP_DIV_POW2: case OP_FIELD_GET_ITEM:
+            return OPND_A | OPND_B;
+        case OP_STRUCT_SET:
+            return OPND_A | OPND_C;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV:
+        case OP_LT: case OP_GT: case OP_EQ:
+        case OP_TABLE_SET: case OP_INDEX: case OP_LIST_GET: case OP_LIST_SET:
+        case OP_ADD_NN: case OP_SUB_NN: case OP_MUL_NN: case OP_DIV_NN: case OP_LT_NN: case OP_GT_NN:
+        case OP_LIST_GET_L: case OP_CONCAT:
+        case OP_VEC_ADD: case OP_VEC_SUB: case OP_VEC_MUL: case OP_VEC_DIV:
+            return OPND_A | OPND_B | OPND_C;
+        default:
+            return 0;
+    }
+}
+
+// true when the instruction stores its result into register a
+inline bool op_writes_a(OpCode op) {
+    switch (op) {
+        case OP_NOP: case OP_JMP: case OP_JMP_FALSE: case OP_JMP_TRUE: case OP_RETURN:
+        case OP_TABLE_SET: case OP_LIST_PUSH: case OP_LIST_SET: case OP_STRUCT_SET:
+            return false;
+        default:
+            return true;
+    }
+}
+
+// calls into bytecode functions
+inline bool op_calls_pc(OpCode op) {
+    return op == OP_CALL || op == OP_CALL_OWN || op == OP_CALL_MEMO;
+}
+
+// calls into another unit carry -2 - slot in b until the linker patches in the pc
+inline int import_call_ref(int slot) { return -2 - slot; }
+inline int import_call_slot(int b) { return -2 - b; }
+
+inline bool op_is_cond_jump(OpCode op) {
+    return op == OP_JMP_FALSE || op == OP_JMP_TRUE;
+}
+
+// true when operand b holds an absolute pc
+inline bool op_has_pc_target(OpCode op) {
+    return op == OP_JMP || op_is_cond_jump(op) || op_calls_pc(op);
+}
+
+// instructions that only allocate a fresh object into register a
+inline bool op_allocates(OpCode op) {
+    return op == OP_TABLE_NEW || op == OP_LIST_NEW || op == OP_STRUCT_NEW || op == OP_CONCAT || op == OP_CONCAT_N ||
+           (op >= OP_VEC_ADD && op <= OP_VEC_DIV);
+}
+
+// no side effects besides writing register a (allocations excluded, each one is a new object)
+inline bool op_is_pure(OpCode op) {
+    switch (op) {
+        case OP_CONST: case OP_MOVE: case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_DIV_POW2:
+        case OP_LT: case OP_GT: case OP_EQ:
+        case OP_INDEX: case OP_STRUCT_GET: case OP_LIST_GET: case OP_LIST_LEN:
+        case OP_ADD_NN: case OP_SUB_NN: case OP_MUL_NN: case OP_DIV_NN: case OP_LT_NN: case OP_GT_NN:
+        case OP_LIST_GET_L: case OP_FIELD_GET_ITEM:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// pure instructions whose result depends on heap contents
+inline bool op_reads_heap(OpCode op) {
+    return op == OP_INDEX || op == OP_STRUCT_GET || op == OP_LIST_GET || op == OP_LIST_LEN ||
+           op == OP_LIST_GET_L || op == OP_FIELD_GET_ITEM;
+}
+
+// stores into a container that replace register a with a fresh one when it holds something else
+inline bool op_may_replace_a(OpCode op) {
+    return op == OP_TABLE_SET || op == OP_LIST_PUSH || op == OP_LIST_SET || op == OP_STRUCT_SET;
+}
+
+// calls read their arguments from registers a+1 .. a+argc, OP_CONCAT_N its strings
+inline int call_arg_count(const Instr& ins) {
+    return (op_calls_pc(ins.op) || ins.op == OP_CALL_OBJ || ins.op == OP_CONCAT_N) ? ins.c : 0;
+}
+
+struct Profile;
+
 struct Assembler {
     std::vector<Instr> code;
     std::vector<Value> constants;
     std::vector<Label> labels;
+    std::vector<FuncInfo> functions;
+    std::vector<OptRemark> remarks;
 
     int make_label();
     void bind_label(int id);
@@ -37,9 +204,39 @@ struct Assembler {
     int emit_call_obj(int line, int dest_reg, int func_reg, int argc);
 
     void run_optimizations(int level, int max_iters);
+    // splices bodies of small non-recursive functions into their call sites; callee_budget,
+    // when given, replaces budget per entry of functions
+    void inline_small_functions(int budget, const std::vector<int>& callee_budget = {});
+    // drops functions no call reachable from the entry code can reach, and the constants
+    // only they used; returns how many were dropped
+    int eliminate_dead_functions();
+    // profile-guided layout of the linked program: likelier side of each if/else first,
+    // hot functions packed behind the entry stub and functions that never ran moved last
+    void apply_profile(const Profile& profile);
+    // per entry of functions: calls no builtin with side effects, only calls pure functions of
+    // this code and stores into no container it was handed
+    std::vector<char> pure_functions() const;
 
 private:
     bool pass_constant_fold_and_propagate();
     bool pass_peep_hole();
+    bool pass_copy_propagate();
+    bool pass_dead_code();
+    bool pass_loop_invariant_motion();
+    bool pass_strength_reduce();
+    bool pass_reduce_division();
+    bool pass_specialize_types();
+    bool pass_scalar_replace();
+    bool pass_evaluate_pure_calls();
+    // last pass: needs the final code, later passes would not know about cleared sources
+    void pass_elide_refcounts();
+    int function_register_ceiling(int pc) const;
     void compact_and_rewrite_labels(const std::vector<int>& removed);
+    // drops removed instructions and inserts before[pc] ahead of pc; jumps into an insertion
+    // land on the inserted code, except back-edges from inside [loop_first, loop_last]
+    void splice_code(const std::vector<char>& removed, const std::vector<std::vector<Instr>>& before,
+                     int loop_first = -1, int loop_last = -1);
+    void rebind_labels(const std::vector<int>& new_pos, int new_size);
+    void order_branches_by_profile(const Profile& profile);
+    void order_functions_by_profile(const Profile& profile);
 };
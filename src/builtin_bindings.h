@@ -1,17 +1,21 @@
 #pragma once
-#include <functional>
 #include "builtin_registry.h"
-#include <type_traits>
 #include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 inline double value_to_number(const Value& v) {
     if (v.is_num()) return v.as_num();
     return 0.0;
 }
 
-inline std::string value_to_string(const Value& v) {
-    if (v.is_obj() && v.as_obj()->type == OBJ_STRING) return ((ObjString*)v.as_obj())->str;
-    return std::string();
+inline std::string_view value_to_string(const Value& v) {
+    if (v.is_obj() && v.as_obj()->type == OBJ_STRING) return ((ObjString*)v.as_obj())->view();
+    return {};
 }
 
 inline Value number_to_value(double d) {
@@ -19,20 +23,122 @@ inline Value number_to_value(double d) {
     return Value::make_intscaled(q);
 }
 
-inline Value string_to_value(const std::string& s) {
-    ObjString* o = new ObjString(s);
+inline Value string_to_value(std::string_view s) {
+    ObjString* o = new ObjString(std::string(s));
     return Value::make_obj(o);
 }
+// s[off, off + len) sharing the characters of s; pieces shorter than SLICE_MIN are copied,
+// they fit inside std::string itself and pin no parent. The whole of s is s, retained.
+inline Value string_slice(const Value& s, size_t off, size_t len) {
+    constexpr size_t SLICE_MIN = 16;
+    ObjString* o = (ObjString*)s.as_obj();
+    if (off == 0 && len == o->view().size()) { retain(s); return s; }
+    if (len < SLICE_MIN) return string_to_value(o->view().substr(off, len));
+    return Value::make_obj(new ObjString(o, off, len));
+}
+
 inline Value bool_to_value(bool b) { return Value::make_bool(b); }
 
+// how one C++ parameter or result type crosses into scripts: its TypeKind, which values an
+// argument accepts, and the conversions. Types without a specialization do not compile.
+template<typename T, typename = void> struct NativeType;
+
+template<> struct NativeType<double> {
+    static constexpr TypeKind kind = TY_NUMBER;
+    static bool accepts(const Value& v) { return v.is_num(); }
+    static double from(const Value& v) { return v.as_num(); }
+    static Value to(double d) { return number_to_value(d); }
+};
+
+// whole numbers: the integer part, truncated toward negative infinity
+template<typename T> struct NativeType<T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>> {
+    static constexpr TypeKind kind = TY_NUMBER;
+    static bool accepts(const Value& v) { return v.is_num(); }
+    static T from(const Value& v) { return (T)(v.as_intscaled() >> INTSCALED_SHIFT); }
+    static Value to(T n) { return Value::make_int((int64_t)n); }
+};
+
+template<> struct NativeType<bool> {
+    static constexpr TypeKind kind = TY_BOOL;
+    static bool accepts(const Value& v) { return v.is_bool(); }
+    static bool from(const Value& v) { return v.as_bool(); }
+    static Value to(bool b) { return bool_to_value(b); }
+};
+
+// views the argument's characters for the duration of the call
+template<> struct NativeType<std::string_view> {
+    static constexpr TypeKind kind = TY_STRING;
+    static bool accepts(const Value& v) { return v.is_obj() && v.as_obj()->type == OBJ_STRING; }
+    static std::string_view from(const Value& v) { return value_to_string(v); }
+    static Value to(std::string_view s) { return string_to_value(s); }
+};
+
+template<> struct NativeType<std::string> {
+    static constexpr TypeKind kind = TY_STRING;
+    static bool accepts(const Value& v) { return NativeType<std::string_view>::accepts(v); }
+    static std::string from(const Value& v) { return std::string(value_to_string(v)); }
+    static Value to(std::string s) { return Value::make_obj(new ObjString(std::move(s))); }
+};
+
+// untyped: the value as the VM holds it, borrowed for arguments and owned for results (retain
+// an argument before returning it)
+template<> struct NativeType<Value> {
+    static constexpr TypeKind kind = TY_UNKNOWN;
+    static bool accepts(const Value&) { return true; }
+    static Value from(const Value& v) { return v; }
+    static Value to(Value v) { return v; }
+};
+
+template<typename F> struct NativeSignature;
+
+template<typename R, typename... Args> struct NativeSignature<R(*)(Args...)> {
+    template<typename T> using Native = NativeType<std::remove_cv_t<std::remove_reference_t<T>>>;
+
+    static TypeKind return_kind() {
+        if constexpr (std::is_void_v<R>) return TY_VOID;
+        else return Native<R>::kind;
+    }
+    static std::vector<TypeKind> param_kinds() { return {Native<Args>::kind...}; }
+
+    // nil when an argument is missing or of the wrong type, like the hand-written builtins
+    static Value call(R (*fn)(Args...), int argc, const Value* argv) {
+        return call(fn, argc, argv, std::index_sequence_for<Args...>{});
+    }
+
+private:
+    template<size_t... I>
+    static Value call(R (*fn)(Args...), int argc, const Value* argv, std::index_sequence<I...>) {
+        if (argc < (int)sizeof...(Args)) return Value::make_nil();
+        if (!(Native<Args>::accepts(argv[I]) && ...)) return Value::make_nil();
+        if constexpr (std::is_void_v<R>) {
+            fn(Native<Args>::from(argv[I])...);
+            return Value::make_nil();
+        } else {
+            return Native<R>::to(fn(Native<Args>::from(argv[I])...));
+        }
+    }
+};
+
+template<auto Fn>
+Value native_bridge(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+    return NativeSignature<decltype(Fn)>::call(Fn, argc, argv);
+}
+
+// binds a C++ function known at compile time: the bridge calls it directly, and the
+// signature the compiler checks calls against comes from its C++ types
+template<auto Fn>
+int register_native(const std::string &name, bool pure = false) {
+    using Sig = NativeSignature<decltype(Fn)>;
+    return BuiltinRegistry::register_builtin(name, &native_bridge<Fn>, nullptr, Sig::return_kind(), Sig::param_kinds(), pure);
+}
+
+// same for a function pointer only known at run time, called through ctx
 template<typename R, typename... Args>
-int register_native_simple(const std::string &name, R(*fn)(Args...),
-                           TypeKind ret = TY_UNKNOWN, std::vector<TypeKind> params = {}) {
-    auto *heap_fn = new std::function<R(Args...)>(fn);
-    BuiltinFn bridge = [](int argc, const Value* argv, void* ctx)->Value {
-        auto *h = (std::function<R(Args...)>*)ctx;
-        return Value::make_nil();
+int register_native_simple(const std::string &name, R (*fn)(Args...), bool pure = false) {
+    using Fp = R (*)(Args...);
+    using Sig = NativeSignature<Fp>;
+    BuiltinFn bridge = [](int argc, const Value* argv, void* ctx) -> Value {
+        return Sig::call(*static_cast<Fp*>(ctx), argc, argv);
     };
-    int id = BuiltinRegistry::register_builtin(name, bridge, heap_fn, ret, params);
-    return id;
+    return BuiltinRegistry::register_builtin(name, bridge, new Fp(fn), Sig::return_kind(), Sig::param_kinds(), pure);
 }
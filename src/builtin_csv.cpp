@@ -0,0 +1,198 @@
+#include "builtin_std.h"
+#include "builtin_registry.h"
+#include "builtin_bindings.h"
+#include "output.h"
+#include "source_manager.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+    // bytes of input below which another worker does not pay for its thread
+    constexpr size_t MIN_CHUNK = 1u << 20;
+    constexpr size_t NPOS = std::string_view::npos;
+
+    enum CellKind : uint8_t { CELL_EMPTY, CELL_NUMBER, CELL_TEXT, CELL_ESCAPED };
+
+    // one field: where its text sits in the file and what it reads as; numbers are parsed
+    // again when their column is filled rather than kept here, keeping a cell at 16 bytes
+    struct Cell {
+        size_t off;
+        uint32_t len;
+        CellKind kind;
+    };
+
+    // the rows of one chunk, column by column
+    struct Chunk {
+        std::vector<std::vector<Cell>> columns;
+        size_t rows = 0;
+    };
+
+    // the field starting at p, a quoted one with "" standing for a quote; returns where the
+    // next field starts and sets row_end when this one ended its row
+    size_t parse_field(std::string_view t, size_t p, size_t end, Cell& c, bool& row_end) {
+        if (p < end && t[p] == '"') {
+            size_t from = p + 1, q = from;
+            bool escaped = false;
+            size_t close;
+            while ((close = t.find('"', q)) != NPOS && close + 1 < end && t[close + 1] == '"') { escaped = true; q = close + 2; }
+            if (close == NPOS || close > end) close = end;
+            c = {from, (uint32_t)(close - from), escaped ? CELL_ESCAPED : CELL_TEXT};
+            p = std::min(close + 1, end);
+            while (p < end && t[p] != ',' && t[p] != '\n') ++p;
+        } else {
+            size_t s = p;
+            while (p < end && t[p] != ',' && t[p] != '\n') ++p;
+            size_t e = p;
+            if (e > s && t[e - 1] == '\r') --e;
+            while (s < e && t[s] == ' ') ++s;
+            while (e > s && t[e - 1] == ' ') --e;
+            c = {s, (uint32_t)(e - s), CELL_EMPTY};
+            int64_t q;
+            if (e > s) c.kind = parse_intscaled(t.substr(s, e - s), q) ? CELL_NUMBER : CELL_TEXT;
+        }
+        row_end = p >= end || t[p] == '\n';
+        return p < end ? p + 1 : end;
+    }
+
+    void parse_rows(std::string_view t, size_t begin, size_t end, size_t ncols, Chunk& out) {
+        out.columns.assign(ncols, {});
+        for (size_t p = begin; p < end;) {
+            if (t[p] == '\n') { ++p; continue; }
+            if (t[p] == '\r' && p + 1 < end && t[p + 1] == '\n') { p += 2; continue; }
+            size_t col = 0;
+            for (bool row_end = false; !row_end; ++col) {
+                Cell c;
+                p = parse_field(t, p, end, c, row_end);
+                if (col < ncols) out.columns[col].push_back(c);
+            }
+            for (; col < ncols; ++col) out.columns[col].push_back({0, 0, CELL_EMPTY});
+            out.rows++;
+        }
+    }
+
+    // row-aligned chunk starts for `parts` workers over [begin, size); newlines inside quoted
+    // fields are skipped, which needs one pass over the text when it has quotes at all
+    std::vector<size_t> chunk_starts(std::string_view t, size_t begin, size_t parts) {
+        std::vector<size_t> starts = {begin};
+        size_t size = t.size(), step = (size - begin) / parts;
+        if (t.find('"', begin) == NPOS) {
+            for (size_t k = 1; k < parts; ++k) {
+                size_t nl = t.find('\n', std::max(begin + k * step, starts.back()));
+                if (nl == NPOS) break;
+                starts.push_back(nl + 1);
+            }
+        } else {
+            bool quoted = false;
+            for (size_t i = begin, next = begin + step; i < size && starts.size() < parts; ++i) {
+                if (t[i] == '"') quoted = !quoted;
+                else if (t[i] == '\n' && !quoted && i + 1 >= next) { starts.push_back(i + 1); next += step; }
+            }
+        }
+        starts.push_back(size);
+        return starts;
+    }
+
+    std::string unescape(std::string_view s) {
+        std::string out;
+        out.reserve(s.size());
+        for (size_t i = 0; i < s.size(); ++i) {
+            out += s[i];
+            if (s[i] == '"' && i + 1 < s.size() && s[i + 1] == '"') ++i;
+        }
+        return out;
+    }
+
+    // load_csv(path): a table of column name -> list, the names read from the first row.
+    // Columns whose fields all read as numbers (empty ones becoming nil) hold numbers,
+    // the others strings sharing the mapped file's characters. nil when the file cannot be read.
+    Value builtin_load_csv(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        if (argc < 1) return Value::make_nil();
+        std::shared_ptr<const SourceBuffer> source;
+        try {
+            source = SourceBuffer::map_file(std::string(value_to_string(argv[0])));
+        } catch (const std::runtime_error&) {
+            return Value::make_nil();
+        }
+        std::string_view t = source->text();
+
+        std::vector<std::string> names;
+        size_t body = 0;
+        for (bool row_end = false; !row_end && body < t.size();) {
+            Cell c;
+            body = parse_field(t, body, t.size(), c, row_end);
+            std::string_view text = t.substr(c.off, c.len);
+            names.push_back(c.kind == CELL_ESCAPED ? unescape(text) : std::string(text));
+        }
+
+        size_t hw = std::max(1u, std::thread::hardware_concurrency());
+        size_t workers = std::clamp<size_t>((t.size() - body) / MIN_CHUNK, 1, hw);
+        std::vector<size_t> starts = chunk_starts(t, body, workers);
+        std::vector<Chunk> chunks(starts.size() - 1);
+        {
+            std::vector<std::thread> pool;
+            for (size_t k = 1; k < chunks.size(); ++k)
+                pool.emplace_back(parse_rows, t, starts[k], starts[k + 1], names.size(), std::ref(chunks[k]));
+            if (!chunks.empty()) parse_rows(t, starts[0], starts[1], names.size(), chunks[0]);
+            for (auto& th : pool) th.join();
+        }
+
+        std::vector<size_t> first_row(chunks.size() + 1, 0);
+        for (size_t k = 0; k < chunks.size(); ++k) first_row[k + 1] = first_row[k] + chunks[k].rows;
+        size_t rows = first_row.back();
+
+        std::vector<ObjList*> lists(names.size());
+        std::vector<char> numeric(names.size());
+        for (size_t col = 0; col < names.size(); ++col) {
+            bool any_number = false, any_text = false;
+            for (const Chunk& ch : chunks)
+                for (const Cell& c : ch.columns[col]) {
+                    any_number |= c.kind == CELL_NUMBER;
+                    any_text |= c.kind == CELL_TEXT || c.kind == CELL_ESCAPED;
+                }
+            numeric[col] = any_number && !any_text;
+            lists[col] = new ObjList();
+            lists[col]->elements.assign(rows, Value::make_nil());
+        }
+
+        // numbers need no allocation, so each chunk fills its own rows in parallel
+        auto fill_numbers = [&](size_t k) {
+            for (size_t col = 0; col < names.size(); ++col) {
+                if (!numeric[col]) continue;
+                Value* out = lists[col]->elements.data() + first_row[k];
+                for (const Cell& c : chunks[k].columns[col]) {
+                    int64_t q = 0;
+                    if (c.kind == CELL_NUMBER) parse_intscaled(t.substr(c.off, c.len), q);
+                    *out++ = c.kind == CELL_NUMBER ? Value::make_intscaled(q) : Value::make_nil();
+                }
+            }
+        };
+        {
+            std::vector<std::thread> pool;
+            for (size_t k = 1; k < chunks.size(); ++k) pool.emplace_back(fill_numbers, k);
+            if (!chunks.empty()) fill_numbers(0);
+            for (auto& th : pool) th.join();
+        }
+
+        // strings retain the file's string, which is not thread-safe
+        Value root = Value::make_obj(new ObjExternalString(t, source));
+        for (size_t col = 0; col < names.size(); ++col) {
+            if (numeric[col]) continue;
+            Value* out = lists[col]->elements.data();
+            for (const Chunk& ch : chunks)
+                for (const Cell& c : ch.columns[col])
+                    *out++ = c.kind == CELL_ESCAPED ? string_to_value(unescape(t.substr(c.off, c.len)))
+                                                    : string_slice(root, c.off, c.len);
+        }
+        release(root);
+
+        ObjTable* table = new ObjTable();
+        for (size_t col = 0; col < names.size(); ++col)
+            table->entries.emplace_back(string_to_value(names[col]), Value::make_obj(lists[col]));
+        return Value::make_obj(table);
+    }
+}
+
+void register_csv_builtins() {
+    BuiltinRegistry::register_builtin("load_csv", &builtin_load_csv, nullptr, TY_TABLE, {TY_STRING});
+}
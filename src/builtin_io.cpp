@@ -0,0 +1,142 @@
+#include "builtin_std.h"
+#include "builtin_registry.h"
+#include "builtin_bindings.h"
+#include "output.h"
+#include "source_manager.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <set>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+    // pages of a mapped file already streamed past are dropped in steps of this size, so
+    // reading a file of any size keeps a bounded resident set
+    constexpr size_t DROP_BEHIND = 64u << 20;
+
+    // a file opened for reading ("r", the whole file mapped, lines handed out from a cursor)
+    // or for writing ("w" truncates, "a" appends, both through an OutputBuffer)
+    struct ObjFile : Obj {
+        std::shared_ptr<const SourceBuffer> source;
+        Value text = Value::make_nil();   // the mapping as one string, parent of every line
+        size_t cursor = 0, dropped = 0;
+
+        int fd = -1;
+        std::unique_ptr<OutputBuffer> writer;
+
+        ObjFile() : Obj(OBJ_FILE) {}
+        ~ObjFile() override { close(); }
+        void close();
+    };
+
+    // files still open when the program ends are flushed then
+    struct OpenWriters {
+        std::set<ObjFile*> files;
+        ~OpenWriters() {
+            for (ObjFile* f : std::set<ObjFile*>(files)) f->close();
+        }
+    };
+    OpenWriters& open_writers() {
+        static OpenWriters w;
+        return w;
+    }
+
+    void ObjFile::close() {
+        if (writer) {
+            writer->flush();
+            writer.reset();
+            ::close(fd);
+            fd = -1;
+            open_writers().files.erase(this);
+        }
+        release(text);
+        text = Value::make_nil();
+        source.reset();
+    }
+
+    ObjFile* as_file(const Value& v) {
+        return (v.is_obj() && v.as_obj()->type == OBJ_FILE) ? (ObjFile*)v.as_obj() : nullptr;
+    }
+
+    // open(path, mode): nil when the file cannot be opened
+    Value builtin_open(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        if (argc < 2) return Value::make_nil();
+        std::string path(value_to_string(argv[0]));
+        std::string_view mode = value_to_string(argv[1]);
+
+        ObjFile* f = new ObjFile();
+        if (mode == "r") {
+            try {
+                f->source = SourceBuffer::map_file(path);
+            } catch (const std::runtime_error&) {
+                delete f;
+                return Value::make_nil();
+            }
+            std::string_view t = f->source->text();
+            if (f->source->mapped()) ::madvise((void*)t.data(), t.size(), MADV_SEQUENTIAL);
+            f->text = Value::make_obj(new ObjExternalString(t, f->source));
+        } else if (mode == "w" || mode == "a") {
+            f->fd = ::open(path.c_str(), O_WRONLY | O_CREAT | (mode == "w" ? O_TRUNC : O_APPEND), 0644);
+            if (f->fd < 0) { delete f; return Value::make_nil(); }
+            f->writer = std::make_unique<OutputBuffer>(f->fd);
+            open_writers().files.insert(f);
+        } else {
+            delete f;
+            return Value::make_nil();
+        }
+        return Value::make_obj(f);
+    }
+
+    // read_lines(f): the next line of f on every call, without its line break, and nil once
+    // the file is exhausted. Lines share the mapped file's characters.
+    Value builtin_read_lines(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        ObjFile* f = argc >= 1 ? as_file(argv[0]) : nullptr;
+        if (!f || !f->source) return Value::make_nil();
+        std::string_view t = f->source->text();
+        if (f->cursor >= t.size()) return Value::make_nil();
+
+        size_t start = f->cursor;
+        size_t nl = t.find('\n', start);
+        size_t end = nl == std::string_view::npos ? t.size() : nl;
+        f->cursor = nl == std::string_view::npos ? t.size() : nl + 1;
+        if (end > start && t[end - 1] == '\r') --end;
+
+        if (f->source->mapped() && start - f->dropped >= DROP_BEHIND) {
+            size_t upto = start & ~(size_t)(sysconf(_SC_PAGESIZE) - 1);
+            ::madvise((void*)(t.data() + f->dropped), upto - f->dropped, MADV_DONTNEED);
+            f->dropped = upto;
+        }
+        return string_slice(f->text, start, end - start);
+    }
+
+    // read_all(f): the rest of the file from where read_lines stopped
+    Value builtin_read_all(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        ObjFile* f = argc >= 1 ? as_file(argv[0]) : nullptr;
+        if (!f || !f->source) return Value::make_nil();
+        size_t size = f->source->text().size(), start = std::min(f->cursor, size);
+        f->cursor = size;
+        return string_slice(f->text, start, size - start);
+    }
+
+    // write(f, s): false when f is not open for writing
+    Value builtin_write(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        ObjFile* f = argc >= 2 ? as_file(argv[0]) : nullptr;
+        if (!f || !f->writer) return Value::make_bool(false);
+        f->writer->write(value_to_string(argv[1]));
+        return Value::make_bool(true);
+    }
+
+    Value builtin_close(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        if (ObjFile* f = argc >= 1 ? as_file(argv[0]) : nullptr) f->close();
+        return Value::make_nil();
+    }
+}
+
+void register_io_builtins() {
+    BuiltinRegistry::register_builtin("open", &builtin_open, nullptr, TY_FILE, {TY_STRING, TY_STRING});
+    BuiltinRegistry::register_builtin("read_lines", &builtin_read_lines, nullptr, TY_STRING, {TY_FILE});
+    BuiltinRegistry::register_builtin("read_all", &builtin_read_all, nullptr, TY_STRING, {TY_FILE});
+    BuiltinRegistry::register_builtin("write", &builtin_write, nullptr, TY_BOOL, {TY_FILE, TY_STRING});
+    BuiltinRegistry::register_builtin("close", &builtin_close, nullptr, TY_VOID, {TY_FILE});
+}
@@ -0,0 +1,361 @@
+#include "builtin_std.h"
+#include "builtin_registry.h"
+#include "builtin_bindings.h"
+#include "output.h"
+#include "string_kernels.h"
+#include <algorithm>
+#include <charconv>
+#include <unordered_map>
+
+namespace {
+    // deeper documents are rejected rather than overflowing the stack; this also stops
+    // json_stringify on a table that contains itself
+    constexpr int MAX_DEPTH = 1024;
+    constexpr size_t NPOS = std::string_view::npos;
+
+    bool is_space(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+    int hex_digit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    bool read_hex4(std::string_view s, size_t i, unsigned& cp) {
+        if (i + 4 > s.size()) return false;
+        cp = 0;
+        for (size_t k = i; k < i + 4; ++k) {
+            int d = hex_digit(s[k]);
+            if (d < 0) return false;
+            cp = cp << 4 | (unsigned)d;
+        }
+        return true;
+    }
+
+    void put_utf8(std::string& out, unsigned cp) {
+        if (cp < 0x80) out += (char)cp;
+        else if (cp < 0x800) { out += (char)(0xC0 | cp >> 6); out += (char)(0x80 | (cp & 0x3F)); }
+        else if (cp < 0x10000) {
+            out += (char)(0xE0 | cp >> 12); out += (char)(0x80 | (cp >> 6 & 0x3F)); out += (char)(0x80 | (cp & 0x3F));
+        } else {
+            out += (char)(0xF0 | cp >> 18); out += (char)(0x80 | (cp >> 12 & 0x3F));
+            out += (char)(0x80 | (cp >> 6 & 0x3F)); out += (char)(0x80 | (cp & 0x3F));
+        }
+    }
+
+    // the characters of a string with backslash escapes, \uXXXX pairs included; false when
+    // an escape is malformed
+    bool unescape(std::string_view s, std::string& out) {
+        out.reserve(s.size());
+        for (size_t i = 0; i < s.size(); ++i) {
+            if (s[i] != '\\') { out += s[i]; continue; }
+            if (++i == s.size()) return false;
+            switch (s[i]) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned cp, lo;
+                    if (!read_hex4(s, i + 1, cp)) return false;
+                    i += 4;
+                    if (cp >= 0xD800 && cp < 0xDC00 && i + 2 < s.size() && s[i + 1] == '\\' && s[i + 2] == 'u'
+                        && read_hex4(s, i + 3, lo) && lo >= 0xDC00 && lo < 0xE000) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                        i += 6;
+                    }
+                    put_utf8(out, cp);
+                    break;
+                }
+                default: return false;
+            }
+        }
+        return true;
+    }
+
+    // one pass over one document, building values as it goes. Strings without escapes share
+    // the document's characters; object keys seen before reuse the string made the first time.
+    struct JsonParser {
+        Value doc;
+        std::string_view t;
+        size_t p = 0;
+        std::unordered_map<std::string_view, Value> keys;
+
+        JsonParser(Value d) : doc(d), t(value_to_string(d)) {}
+        ~JsonParser() {
+            for (auto& [k, v] : keys) release(v);
+        }
+
+        void skip_space() {
+            while (p < t.size() && is_space(t[p])) ++p;
+        }
+
+        // the raw characters between the quotes at p, which is left past the closing one
+        bool scan_string(size_t& from, size_t& len, bool& escaped) {
+            from = ++p;
+            escaped = false;
+            for (size_t q = from;;) {
+                size_t at = string_find_either(t, '"', '\\', q);
+                if (at == NPOS) return false;
+                if (t[at] == '"') { len = at - from; p = at + 1; return true; }
+                escaped = true;
+                q = at + 2;
+            }
+        }
+
+        bool parse_string(Value& out) {
+            size_t from, len;
+            bool escaped;
+            if (!scan_string(from, len, escaped)) return false;
+            if (!escaped) { out = string_slice(doc, from, len); return true; }
+            std::string s;
+            if (!unescape(t.substr(from, len), s)) return false;
+            out = Value::make_obj(new ObjString(std::move(s)));
+            return true;
+        }
+
+        bool parse_key(Value& out) {
+            size_t from, len;
+            bool escaped;
+            if (!scan_string(from, len, escaped)) return false;
+            std::string s;
+            std::string_view text = t.substr(from, len);
+            if (escaped) {
+                if (!unescape(text, s)) return false;
+                text = s;
+            }
+            auto it = keys.find(text);
+            if (it == keys.end()) {
+                Value k = string_to_value(text);
+                it = keys.emplace(value_to_string(k), k).first;
+            }
+            out = it->second;
+            retain(out);
+            return true;
+        }
+
+        bool parse_number(Value& out) {
+            size_t s = p;
+            bool fraction_only = true;
+            while (p < t.size()) {
+                char c = t[p];
+                if (c == 'e' || c == 'E') fraction_only = false;
+                else if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.')) break;
+                ++p;
+            }
+            std::string_view text = t.substr(s, p - s);
+            int64_t q;
+            if (fraction_only && parse_intscaled(text, q)) { out = Value::make_intscaled(q); return true; }
+            double d;
+            auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), d);
+            if (ec != std::errc() || end != text.data() + text.size()) return false;
+            out = number_to_value(d);
+            return true;
+        }
+
+        bool parse_literal(std::string_view word, Value v, Value& out) {
+            if (t.substr(p, word.size()) != word) return false;
+            p += word.size();
+            out = v;
+            return true;
+        }
+
+        bool parse_list(Value& out, int depth) {
+            ObjList* l = new ObjList();
+            out = Value::make_obj(l);
+            ++p;
+            skip_space();
+            if (p < t.size() && t[p] == ']') { ++p; return true; }
+            for (;;) {
+                Value v;
+                bool ok = parse_value(v, depth + 1);
+                l->elements.push_back(v);
+                if (!ok) return false;
+                skip_space();
+                if (p >= t.size()) return false;
+                if (t[p++] == ']') return true;
+                if (t[p - 1] != ',') return false;
+            }
+        }
+
+        // a key given twice keeps its first value, as indexing would find it anyway
+        bool parse_table(Value& out, int depth) {
+            ObjTable* tbl = new ObjTable();
+            out = Value::make_obj(tbl);
+            ++p;
+            skip_space();
+            if (p < t.size() && t[p] == '}') { ++p; return true; }
+            for (;;) {
+                Value k, v;
+                skip_space();
+                if (p >= t.size() || t[p] != '"' || !parse_key(k)) return false;
+                skip_space();
+                if (p >= t.size() || t[p++] != ':') { release(k); return false; }
+                bool ok = parse_value(v, depth + 1);
+                tbl->entries.emplace_back(k, v);
+                if (!ok) return false;
+                skip_space();
+                if (p >= t.size()) return false;
+                if (t[p++] == '}') return true;
+                if (t[p - 1] != ',') return false;
+            }
+        }
+
+        // on failure out holds whatever was built so far, for the caller to release
+        bool parse_value(Value& out, int depth) {
+            out = Value::make_nil();
+            skip_space();
+            if (p >= t.size() || depth > MAX_DEPTH) return false;
+            switch (t[p]) {
+                case '{': return parse_table(out, depth);
+                case '[': return parse_list(out, depth);
+                case '"': return parse_string(out);
+                case 't': return parse_literal("true", Value::make_bool(true), out);
+                case 'f': return parse_literal("false", Value::make_bool(false), out);
+                case 'n': return parse_literal("null", Value::make_nil(), out);
+                default: return parse_number(out);
+            }
+        }
+    };
+
+    // json_parse(s): objects become tables, arrays lists, null nil; nil for malformed input
+    Value builtin_json_parse(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        if (argc < 1 || !argv[0].is_obj() || argv[0].as_obj()->type != OBJ_STRING) return Value::make_nil();
+        JsonParser parser(argv[0]);
+        Value v;
+        bool ok = parser.parse_value(v, 0);
+        parser.skip_space();
+        if (!ok || parser.p != parser.t.size()) {
+            release(v);
+            return Value::make_nil();
+        }
+        return v;
+    }
+
+    // how a table key is written: strings as they are, numbers and bools as print shows them
+    std::string_view key_text(Value k, char* buf) {
+        if (k.is_num()) return {buf, format_intscaled(k.as_intscaled(), buf)};
+        if (k.is_bool()) return k.as_bool() ? "true" : "false";
+        if (k.is_obj() && k.as_obj()->type == OBJ_STRING) return value_to_string(k);
+        return "null";
+    }
+
+    size_t escaped_size(std::string_view s) {
+        size_t n = s.size() + 2;
+        for (unsigned char c : s) {
+            if (c == '"' || c == '\\' || c == '\b' || c == '\f' || c == '\n' || c == '\r' || c == '\t') n += 1;
+            else if (c < 0x20) n += 5;
+        }
+        return n;
+    }
+
+    char* write_escaped(std::string_view s, char* out) {
+        static const char HEX[] = "0123456789abcdef";
+        *out++ = '"';
+        for (unsigned char c : s) {
+            char e = 0;
+            switch (c) {
+                case '"': e = '"'; break;
+                case '\\': e = '\\'; break;
+                case '\b': e = 'b'; break;
+                case '\f': e = 'f'; break;
+                case '\n': e = 'n'; break;
+                case '\r': e = 'r'; break;
+                case '\t': e = 't'; break;
+            }
+            if (e) { *out++ = '\\'; *out++ = e; }
+            else if (c < 0x20) { out = std::copy_n("\\u00", 4, out); *out++ = HEX[c >> 4]; *out++ = HEX[c & 15]; }
+            else *out++ = (char)c;
+        }
+        *out++ = '"';
+        return out;
+    }
+
+    Obj* as_container(Value v) {
+        if (!v.is_obj()) return nullptr;
+        Obj* o = v.as_obj();
+        return o && (o->type == OBJ_LIST || o->type == OBJ_TABLE) ? o : nullptr;
+    }
+
+    // the exact length json_write produces for v, NPOS past MAX_DEPTH
+    size_t json_size(Value v, int depth) {
+        char buf[32];
+        if (depth > MAX_DEPTH) return NPOS;
+        if (v.is_num()) return format_intscaled(v.as_intscaled(), buf);
+        if (v.is_bool()) return v.as_bool() ? 4 : 5;
+        if (v.is_obj() && v.as_obj() && v.as_obj()->type == OBJ_STRING) return escaped_size(value_to_string(v));
+        Obj* o = as_container(v);
+        if (!o) return 4;
+        size_t n = 2;
+        if (o->type == OBJ_LIST) {
+            const auto& els = ((ObjList*)o)->elements;
+            n += els.empty() ? 0 : els.size() - 1;
+            for (Value e : els) {
+                size_t m = json_size(e, depth + 1);
+                if (m == NPOS) return NPOS;
+                n += m;
+            }
+        } else {
+            const auto& entries = ((ObjTable*)o)->entries;
+            n += entries.empty() ? 0 : entries.size() - 1;
+            for (auto& [k, e] : entries) {
+                size_t m = json_size(e, depth + 1);
+                if (m == NPOS) return NPOS;
+                n += escaped_size(key_text(k, buf)) + 1 + m;
+            }
+        }
+        return n;
+    }
+
+    char* json_write(Value v, char* out) {
+        char buf[32];
+        if (v.is_num()) return std::copy_n(buf, format_intscaled(v.as_intscaled(), buf), out);
+        if (v.is_bool()) return v.as_bool() ? std::copy_n("true", 4, out) : std::copy_n("false", 5, out);
+        if (v.is_obj() && v.as_obj() && v.as_obj()->type == OBJ_STRING) return write_escaped(value_to_string(v), out);
+        Obj* o = as_container(v);
+        if (!o) return std::copy_n("null", 4, out);
+        if (o->type == OBJ_LIST) {
+            *out++ = '[';
+            const auto& els = ((ObjList*)o)->elements;
+            for (size_t i = 0; i < els.size(); ++i) {
+                if (i) *out++ = ',';
+                out = json_write(els[i], out);
+            }
+            *out++ = ']';
+        } else {
+            *out++ = '{';
+            const auto& entries = ((ObjTable*)o)->entries;
+            for (size_t i = 0; i < entries.size(); ++i) {
+                if (i) *out++ = ',';
+                out = write_escaped(key_text(entries[i].first, buf), out);
+                *out++ = ':';
+                out = json_write(entries[i].second, out);
+            }
+            *out++ = '}';
+        }
+        return out;
+    }
+
+    // json_stringify(v): compact JSON, measured first so it is written into a string of
+    // exactly its size. Values JSON has no form for (items, files) are written as null;
+    // nil when v nests too deeply, e.g. contains itself.
+    Value builtin_json_stringify(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        Value v = argc >= 1 ? argv[0] : Value::make_nil();
+        size_t n = json_size(v, 0);
+        if (n == NPOS) return Value::make_nil();
+        ObjString* s = new ObjString(std::string());
+        s->str.resize(n);
+        json_write(v, s->str.data());
+        return Value::make_obj(s);
+    }
+}
+
+void register_json_builtins() {
+    BuiltinRegistry::register_builtin("json_parse", &builtin_json_parse, nullptr, TY_UNKNOWN, {TY_STRING});
+    BuiltinRegistry::register_builtin("json_stringify", &builtin_json_stringify, nullptr, TY_STRING, {TY_UNKNOWN});
+}
@@ -0,0 +1,158 @@
+#include "builtin_std.h"
+#include "builtin_registry.h"
+#include "builtin_bindings.h"
+#include <algorithm>
+#include <thread>
+#include <unordered_set>
+
+namespace {
+    // below this many elements a sort stays on the calling thread
+    constexpr size_t PARALLEL_MIN = 1u << 16;
+
+    ObjList* as_list(const Value& v) {
+        return (v.is_obj() && v.as_obj() && v.as_obj()->type == OBJ_LIST) ? (ObjList*)v.as_obj() : nullptr;
+    }
+
+    int rank(const Value& v) {
+        if (v.is_nil()) return 0;
+        if (v.is_bool()) return 1;
+        if (v.is_num()) return 2;
+        if (v.is_obj() && v.as_obj() && v.as_obj()->type == OBJ_STRING) return 3;
+        return 4;
+    }
+
+    // the order the sorting builtins use: nil, bools, numbers, strings by their bytes, then
+    // everything else, which compares equal among itself
+    bool value_less(const Value& a, const Value& b) {
+        int ra = rank(a), rb = rank(b);
+        if (ra != rb) return ra < rb;
+        switch (ra) {
+            case 1: return !a.as_bool() && b.as_bool();
+            case 2: return a.as_intscaled() < b.as_intscaled();
+            case 3: return value_to_string(a) < value_to_string(b);
+            default: return false;
+        }
+    }
+
+    // introsort, or merge sort when stable, on the calling thread for small inputs. Larger
+    // ones are cut into a run per core, the runs sorted in parallel and then merged pairwise,
+    // each round's merges in parallel too.
+    template<typename T, typename Less>
+    void parallel_sort(std::vector<T>& v, Less less, bool stable) {
+        size_t n = v.size();
+        size_t hw = std::max(1u, std::thread::hardware_concurrency());
+        size_t runs = std::min(hw, n / PARALLEL_MIN);
+        auto sort_range = [&](size_t b, size_t e) {
+            if (stable) std::stable_sort(v.begin() + b, v.begin() + e, less);
+            else std::sort(v.begin() + b, v.begin() + e, less);
+        };
+        if (runs < 2) { sort_range(0, n); return; }
+
+        std::vector<size_t> bounds;
+        for (size_t k = 0; k <= runs; ++k) bounds.push_back(n * k / runs);
+        {
+            std::vector<std::thread> pool;
+            for (size_t k = 1; k < runs; ++k) pool.emplace_back(sort_range, bounds[k], bounds[k + 1]);
+            sort_range(bounds[0], bounds[1]);
+            for (auto& th : pool) th.join();
+        }
+
+        std::vector<T> scratch(n);
+        T* src = v.data();
+        T* dst = scratch.data();
+        while (bounds.size() > 2) {
+            std::vector<size_t> next = {0};
+            std::vector<std::thread> pool;
+            for (size_t k = 0; k + 1 < bounds.size(); k += 2) {
+                size_t b = bounds[k], m = bounds[k + 1], e = k + 2 < bounds.size() ? bounds[k + 2] : m;
+                pool.emplace_back([=] { std::merge(src + b, src + m, src + m, src + e, dst + b, less); });
+                next.push_back(e);
+            }
+            for (auto& th : pool) th.join();
+            bounds = std::move(next);
+            std::swap(src, dst);
+        }
+        if (src != v.data()) std::copy(src, src + n, v.data());
+    }
+
+    // sort(l): in place, in the order of value_less
+    Value builtin_sort(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        if (ObjList* l = argc >= 1 ? as_list(argv[0]) : nullptr) parallel_sort(l->elements, value_less, false);
+        return Value::make_nil();
+    }
+
+    // what sort_by orders e by: field `key` (counted from 1) of an item or list, entry `key` of a table
+    Value key_of(const Value& e, const Value& key) {
+        if (!e.is_obj() || !e.as_obj()) return Value::make_nil();
+        Obj* o = e.as_obj();
+        if (o->type == OBJ_TABLE) {
+            for (auto& [k, v] : ((ObjTable*)o)->entries)
+                if (value_equal(k, key)) return v;
+            return Value::make_nil();
+        }
+        if (!key.is_num()) return Value::make_nil();
+        int64_t i = (key.as_intscaled() >> INTSCALED_SHIFT) - 1;
+        const std::vector<Value>* fields = o->type == OBJ_STRUCT ? &((ObjStruct*)o)->fields
+                                         : o->type == OBJ_LIST ? &((ObjList*)o)->elements : nullptr;
+        return fields && i >= 0 && (size_t)i < fields->size() ? (*fields)[(size_t)i] : Value::make_nil();
+    }
+
+    // sort_by(l, key): in place by each element's key, keeping elements with equal keys in order.
+    // Keys are looked up once, not on every comparison.
+    Value builtin_sort_by(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        ObjList* l = argc >= 2 ? as_list(argv[0]) : nullptr;
+        if (!l) return Value::make_nil();
+        std::vector<std::pair<Value, Value>> keyed;
+        keyed.reserve(l->elements.size());
+        for (Value e : l->elements) keyed.emplace_back(key_of(e, argv[1]), e);
+        parallel_sort(keyed, [](const auto& a, const auto& b) { return value_less(a.first, b.first); }, true);
+        for (size_t i = 0; i < keyed.size(); ++i) l->elements[i] = keyed[i].second;
+        return Value::make_nil();
+    }
+
+    // binary_search(l, v): the position of v in sorted l counted from 1, -1 when absent
+    Value builtin_binary_search(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        ObjList* l = argc >= 2 ? as_list(argv[0]) : nullptr;
+        if (!l) return Value::make_int(-1);
+        auto it = std::lower_bound(l->elements.begin(), l->elements.end(), argv[1], value_less);
+        if (it == l->elements.end() || !value_equal(*it, argv[1])) return Value::make_int(-1);
+        return Value::make_int(it - l->elements.begin() + 1);
+    }
+
+    struct ValueHash {
+        size_t operator()(const Value& v) const {
+            if (v.is_obj() && v.as_obj() && v.as_obj()->type == OBJ_STRING) return std::hash<std::string_view>{}(value_to_string(v));
+            return std::hash<uint64_t>{}((uint64_t)v.raw);
+        }
+    };
+    struct ValueEqual {
+        bool operator()(const Value& a, const Value& b) const { return value_equal(a, b); }
+    };
+
+    // unique(l): drops, in place, every element equal to one before it
+    Value builtin_unique(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        ObjList* l = argc >= 1 ? as_list(argv[0]) : nullptr;
+        if (!l) return Value::make_nil();
+        std::unordered_set<Value, ValueHash, ValueEqual> seen(l->elements.size());
+        size_t kept = 0;
+        for (Value e : l->elements) {
+            if (seen.insert(e).second) l->elements[kept++] = e;
+            else release(e);
+        }
+        l->elements.resize(kept);
+        return Value::make_nil();
+    }
+
+    Value builtin_reverse(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        if (ObjList* l = argc >= 1 ? as_list(argv[0]) : nullptr) std::reverse(l->elements.begin(), l->elements.end());
+        return Value::make_nil();
+    }
+}
+
+void register_list_builtins() {
+    BuiltinRegistry::register_builtin("sort", &builtin_sort, nullptr, TY_VOID, {TY_LIST});
+    BuiltinRegistry::register_builtin("sort_by", &builtin_sort_by, nullptr, TY_VOID, {TY_LIST, TY_UNKNOWN});
+    BuiltinRegistry::register_builtin("binary_search", &builtin_binary_search, nullptr, TY_NUMBER, {TY_LIST, TY_UNKNOWN});
+    BuiltinRegistry::register_builtin("unique", &builtin_unique, nullptr, TY_VOID, {TY_LIST});
+    BuiltinRegistry::register_builtin("reverse", &builtin_reverse, nullptr, TY_VOID, {TY_LIST});
+}
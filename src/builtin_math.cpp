@@ -0,0 +1,111 @@
+#include "builtin_std.h"
+#include "builtin_registry.h"
+#include "fixed_math.h"
+#include "vec_kernels.h"
+#include <algorithm>
+
+namespace {
+    using FixedFn = bool (*)(int64_t, int64_t&);
+
+    ObjList* as_list(const Value& v) {
+        return (v.is_obj() && v.as_obj() && v.as_obj()->type == OBJ_LIST) ? (ObjList*)v.as_obj() : nullptr;
+    }
+
+    bool floor_of(int64_t q, int64_t& out) { out = fixed_floor(q); return true; }
+    bool abs_of(int64_t q, int64_t& out) { out = fixed_abs(q); return true; }
+
+    // f of one number, nil for anything else or outside f's domain
+    template<FixedFn F>
+    inline Value apply(const Value& x) {
+        int64_t r;
+        return x.is_num() && F(x.as_intscaled(), r) ? Value::make_intscaled(r) : Value::make_nil();
+    }
+
+    template<FixedFn F>
+    Value builtin_unary(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        return argc >= 1 ? apply<F>(argv[0]) : Value::make_nil();
+    }
+
+    // the batch form: f over a whole list in one call, into a new list
+    template<FixedFn F>
+    Value builtin_unary_list(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        ObjList* in = argc >= 1 ? as_list(argv[0]) : nullptr;
+        if (!in) return Value::make_nil();
+        ObjList* out = new ObjList();
+        out->elements.resize(in->elements.size());
+        const Value* src = in->elements.data();
+        Value* dst = out->elements.data();
+        for (size_t i = 0, n = in->elements.size(); i < n; ++i) dst[i] = apply<F>(src[i]);
+        return Value::make_obj(out);
+    }
+
+    Value pow_of(const Value& x, const Value& y) {
+        int64_t r;
+        return x.is_num() && y.is_num() && fixed_pow(x.as_intscaled(), y.as_intscaled(), r) ? Value::make_intscaled(r)
+                                                                                           : Value::make_nil();
+    }
+
+    Value builtin_pow(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        return argc >= 2 ? pow_of(argv[0], argv[1]) : Value::make_nil();
+    }
+
+    // pow(l, y): every element of l to the power y
+    Value builtin_pow_list(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        ObjList* in = argc >= 2 ? as_list(argv[0]) : nullptr;
+        if (!in) return Value::make_nil();
+        ObjList* out = new ObjList();
+        out->elements.reserve(in->elements.size());
+        for (const Value& x : in->elements) out->elements.push_back(pow_of(x, argv[1]));
+        return Value::make_obj(out);
+    }
+
+    template<VecOp OP>
+    Value builtin_pick(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        if (argc < 2 || !argv[0].is_num() || !argv[1].is_num()) return Value::make_nil();
+        bool second = OP == VEC_MIN ? argv[1].as_intscaled() < argv[0].as_intscaled()
+                                    : argv[1].as_intscaled() > argv[0].as_intscaled();
+        return argv[second ? 1 : 0];
+    }
+
+    // min(l, x) / max(l, x) element by element, x a number or a list paired up as far as
+    // the shorter goes
+    template<VecOp OP>
+    Value builtin_pick_list(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        ObjList* l = argc >= 2 ? as_list(argv[0]) : nullptr;
+        if (!l) return Value::make_nil();
+        ObjList* r = as_list(argv[1]);
+        size_t n = r ? std::min(l->elements.size(), r->elements.size()) : l->elements.size();
+        ObjList* out = new ObjList();
+        out->elements.assign(n, Value::make_nil());
+        vec_arith(OP, l->elements.data(), false, r ? r->elements.data() : &argv[1], !r, out->elements.data(), n, false);
+        return Value::make_obj(out);
+    }
+
+    // f(x) for a number and f(l) for a list, the second a batch over its elements
+    template<FixedFn F>
+    void register_unary(const std::string& name) {
+        BuiltinRegistry::register_builtin(name, &builtin_unary<F>, nullptr, TY_NUMBER, {TY_NUMBER}, true);
+        BuiltinRegistry::register_builtin(name, &builtin_unary_list<F>, nullptr, TY_LIST, {TY_LIST}, true);
+    }
+
+    template<VecOp OP>
+    void register_pick(const std::string& name) {
+        BuiltinRegistry::register_builtin(name, &builtin_pick<OP>, nullptr, TY_NUMBER, {TY_NUMBER, TY_NUMBER}, true);
+        BuiltinRegistry::register_builtin(name, &builtin_pick_list<OP>, nullptr, TY_LIST, {TY_LIST, TY_NUMBER}, true);
+        BuiltinRegistry::register_builtin(name, &builtin_pick_list<OP>, nullptr, TY_LIST, {TY_LIST, TY_LIST}, true);
+    }
+}
+
+void register_math_builtins() {
+    register_unary<fixed_sin>("sin");
+    register_unary<fixed_cos>("cos");
+    register_unary<fixed_sqrt>("sqrt");
+    register_unary<fixed_exp>("exp");
+    register_unary<fixed_log>("log");
+    register_unary<floor_of>("floor");
+    register_unary<abs_of>("abs");
+    BuiltinRegistry::register_builtin("pow", &builtin_pow, nullptr, TY_NUMBER, {TY_NUMBER, TY_NUMBER}, true);
+    BuiltinRegistry::register_builtin("pow", &builtin_pow_list, nullptr, TY_LIST, {TY_LIST, TY_NUMBER}, true);
+    register_pick<VEC_MIN>("min");
+    register_pick<VEC_MAX>("max");
+}
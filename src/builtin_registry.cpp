@@ -4,7 +4,8 @@
 static std::vector<BuiltinEntry> g_builtin_entries;
 static std::mutex g_builtin_mutex;
 
-int BuiltinRegistry::register_builtin(const std::string &name, BuiltinFn fn, void* ctx, TypeKind ret, const std::vector<TypeKind>& params) {
+int BuiltinRegistry::register_builtin(const std::string &name, BuiltinFn fn, void* ctx, TypeKind ret, const std::vector<TypeKind>& params,
+                                      bool pure) {
     std::lock_guard<std::mutex> lk(g_builtin_mutex);
     BuiltinEntry e;
     e.name = name;
@@ -12,6 +13,7 @@ int BuiltinRegistry::register_builtin(const std::string &name, BuiltinFn fn, voi
     e.ctx = ctx;
     e.return_type = ret;
     e.param_types = params;
+    e.pure = pure;
     g_builtin_entries.push_back(std::move(e));
     return (int)g_builtin_entries.size() - 1;
 }
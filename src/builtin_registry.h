@@ -4,7 +4,8 @@
 #include <functional>
 #include "value.h"
 
-// (argc, argv, ctx) -> Value
+// (argc, argv, ctx) -> Value. The result is a reference the caller takes over: new objects
+// are returned as made, values taken from the arguments retained first.
 using BuiltinFn = Value(*)(int, const Value*, void*);
 
 struct BuiltinEntry {
@@ -13,10 +14,13 @@ struct BuiltinEntry {
     void* ctx;
     TypeKind return_type;
     std::vector<TypeKind> param_types;
+    // no side effects and the result depends only on the arguments: callable at compile time
+    bool pure = false;
 };
 
 struct BuiltinRegistry {
-    static int register_builtin(const std::string &name, BuiltinFn fn, void* ctx, TypeKind ret, const std::vector<TypeKind>& params);
+    static int register_builtin(const std::string &name, BuiltinFn fn, void* ctx, TypeKind ret, const std::vector<TypeKind>& params,
+                                bool pure = false);
     static const BuiltinEntry* get_entry(int id);
     static int lookup_name(const std::string &name);
     static int lookup_name(const std::string &name, const std::vector<TypeKind>& params);
@@ -1,108 +1,106 @@
 #include "builtin_std.h"
 #include "builtin_registry.h"
-// #include "builtin_bindings.h" // unused
-#include <cmath>
-#include <iostream>
-#include <sstream>
-#include <iomanip>
+#include "builtin_bindings.h"
+#include "output.h"
 
 namespace {
-    std::string value_to_short_string(const Value& v) {
-        if (v.is_obj() && v.as_obj()->type == OBJ_STRING) return ((ObjString*)v.as_obj())->str;
+    // print's rendering of a value, lists shortened to their first 8 elements
+    void append_short(OutputBuffer& out, const Value& v) {
+        if (v.is_obj() && v.as_obj()->type == OBJ_STRING) { out.write(((ObjString*)v.as_obj())->view()); return; }
         if (v.is_num()) {
-            std::ostringstream ss;
-            ss << std::fixed << std::setprecision(6) << v.as_num();
-            std::string out = ss.str();
-            if (out.find('.') != std::string::npos) {
-                while (!out.empty() && out.back() == '0') out.pop_back();
-                if (!out.empty() && out.back() == '.') out.pop_back();
-            }
-            return out;
+            char buf[32];
+            out.write({buf, format_intscaled(v.as_intscaled(), buf)});
+            return;
         }
-        if (v.is_bool()) return v.as_bool() ? "true" : "false";
+        if (v.is_bool()) { out.write(v.as_bool() ? "true" : "false"); return; }
         if (v.is_obj() && v.as_obj()->type == OBJ_LIST) {
             ObjList* a = (ObjList*)v.as_obj();
-            std::string s = "[";
+            out.put('[');
             for (size_t i = 0; i < a->elements.size() && i < 8; ++i) {
-                if (i) s += ", ";
-                s += value_to_short_string(a->elements[i]);
+                if (i) out.write(", ");
+                append_short(out, a->elements[i]);
             }
-            if (a->elements.size() > 8) s += ", ...";
-            s += "]";
-            return s;
+            if (a->elements.size() > 8) out.write(", ...");
+            out.put(']');
+            return;
         }
-        return "nil";
+        out.write("nil");
     }
 
     Value builtin_print_string(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
-        if (argc < 1) { std::cout << "\n"; return Value::make_nil(); }
-        const Value& v = argv[0];
-        if (v.is_obj() && v.as_obj()->type == OBJ_STRING) std::cout << ((ObjString*)v.as_obj())->str << "\n";
-        else std::cout << value_to_short_string(v) << "\n";
+        OutputBuffer& out = OutputBuffer::current();
+        if (argc >= 1) append_short(out, argv[0]);
+        out.end_line();
         return Value::make_nil();
     }
 
     Value builtin_print_number(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
-        if (argc < 1) { std::cout << "\n"; return Value::make_nil(); }
-        const Value& v = argv[0];
-        if (!v.is_num()) { std::cout << "nil\n"; return Value::make_nil(); }
-        double d = v.as_num();
-        std::ostringstream ss;
-        ss << std::fixed << std::setprecision(6) << d;
-        std::string out = ss.str();
-        if (out.find('.') != std::string::npos) {
-            while (!out.empty() && out.back() == '0') out.pop_back();
-            if (!out.empty() && out.back() == '.') out.pop_back();
+        OutputBuffer& out = OutputBuffer::current();
+        if (argc >= 1) {
+            if (argv[0].is_num()) append_short(out, argv[0]);
+            else out.write("nil");
         }
-        std::cout << out << "\n";
+        out.end_line();
         return Value::make_nil();
     }
 
     Value builtin_print_array(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
-        if (argc < 1) { std::cout << "[]\n"; return Value::make_nil(); }
+        OutputBuffer& out = OutputBuffer::current();
+        if (argc < 1) { out.write("[]"); out.end_line(); return Value::make_nil(); }
         const Value& v = argv[0];
-        if (!(v.is_obj() && v.as_obj()->type == OBJ_LIST)) { std::cout << "nil\n"; return Value::make_nil(); }
+        if (!(v.is_obj() && v.as_obj()->type == OBJ_LIST)) { out.write("nil"); out.end_line(); return Value::make_nil(); }
         ObjList* arr = (ObjList*)v.as_obj();
-        std::cout << "[";
+        out.put('[');
         for (size_t i = 0; i < arr->elements.size(); ++i) {
-            if (i) std::cout << ", ";
-            std::cout << value_to_short_string(arr->elements[i]);
+            if (i) out.write(", ");
+            append_short(out, arr->elements[i]);
         }
-        std::cout << "]\n";
+        out.put(']');
+        out.end_line();
         return Value::make_nil();
     }
 
-    Value builtin_len_string(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
-        if (argc < 1) return Value::make_nil();
-        const Value& v = argv[0];
-        if (!(v.is_obj() && v.as_obj()->type == OBJ_STRING)) return Value::make_nil();
-        ObjString* s = (ObjString*)v.as_obj();
-        int64_t len = (int64_t)s->str.size();
-        return Value::make_int(len);
-    }
+    // join(parts, sep): the builder for strings made piece by piece, sized once and
+    // filled in one pass; numbers and bools are written the way print writes them
+    Value builtin_join(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        if (argc < 2 || !(argv[0].is_obj() && argv[0].as_obj()->type == OBJ_LIST)) return Value::make_nil();
+        const std::vector<Value>& parts = ((ObjList*)argv[0].as_obj())->elements;
+        std::string_view sep = value_to_string(argv[1]);
+        size_t total = parts.empty() ? 0 : sep.size() * (parts.size() - 1);
+        for (const Value& p : parts) total += p.is_num() ? 24 : value_to_string(p).size();
 
-    Value builtin_sin_1(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
-        if (argc < 1 || !argv[0].is_num()) return Value::make_nil();
-        double x = argv[0].as_num();
-        double r = sin(x);
-        int64_t q = (int64_t) llround(r * (long double)INTSCALED_ONE);
-        return Value::make_intscaled(q);
+        std::string s;
+        s.reserve(total);
+        for (size_t i = 0; i < parts.size(); ++i) {
+            if (i) s += sep;
+            const Value& p = parts[i];
+            if (p.is_num()) {
+                char buf[32];
+                s.append(buf, format_intscaled(p.as_intscaled(), buf));
+            } else if (p.is_bool()) {
+                s += p.as_bool() ? "true" : "false";
+            } else if (p.is_obj() && p.as_obj()->type == OBJ_STRING) {
+                s += ((ObjString*)p.as_obj())->view();
+            } else {
+                s += "nil";
+            }
+        }
+        return Value::make_obj(new ObjString(std::move(s)));
     }
 
-    Value builtin_cos_1(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
-        if (argc < 1 || !argv[0].is_num()) return Value::make_nil();
-        double x = argv[0].as_num();
-        double r = cos(x);
-        int64_t q = (int64_t) llround(r * (long double)INTSCALED_ONE);
-        return Value::make_intscaled(q);
-    }
+    int64_t native_len(std::string_view s) { return (int64_t)s.size(); }
 }
 
 void register_default_builtins() {
     BuiltinRegistry::register_builtin("print", &builtin_print_string, nullptr, TY_VOID, {TY_STRING});
     BuiltinRegistry::register_builtin("print", &builtin_print_number, nullptr, TY_VOID, {TY_NUMBER});
     BuiltinRegistry::register_builtin("print", &builtin_print_array, nullptr, TY_VOID, {TY_LIST});
-    BuiltinRegistry::register_builtin("len", &builtin_len_string, nullptr, TY_NUMBER, {TY_STRING});
-    BuiltinRegistry::register_builtin("sin", &builtin_sin_1, nullptr, TY_NUMBER, {TY_NUMBER});
-    BuiltinRegistry::register_builtin("cos", &builtin_cos_1, nullptr, TY_NUMBER, {TY_NUMBER});
+    register_native<&native_len>("len", true);
+    BuiltinRegistry::register_builtin("join", &builtin_join, nullptr, TY_STRING, {TY_LIST, TY_STRING}, true);
+    register_string_builtins();
+    register_io_builtins();
+    register_csv_builtins();
+    register_json_builtins();
+    register_list_builtins();
+    register_math_builtins();
 }
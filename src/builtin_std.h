@@ -2,3 +2,16 @@
 #include "value.h"
 
 void register_default_builtins();
+// sub, trim, split, find, count, starts_with; called by register_default_builtins
+void register_string_builtins();
+// open, read_lines, read_all, write, close; called by register_default_builtins
+void register_io_builtins();
+// load_csv; called by register_default_builtins
+void register_csv_builtins();
+// json_parse, json_stringify; called by register_default_builtins
+void register_json_builtins();
+// sort, sort_by, binary_search, unique, reverse; called by register_default_builtins
+void register_list_builtins();
+// sin, cos, sqrt, exp, log, floor, abs, pow, min, max with their list forms; called by
+// register_default_builtins
+void register_math_builtins();
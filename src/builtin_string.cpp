@@ -0,0 +1,67 @@
+#include "builtin_std.h"
+#include "builtin_registry.h"
+#include "builtin_bindings.h"
+#include "string_kernels.h"
+#include <algorithm>
+
+namespace {
+    bool is_string(const Value& v) { return v.is_obj() && v.as_obj()->type == OBJ_STRING; }
+
+    size_t clamp_index(const Value& v, size_t size) {
+        int64_t i = v.is_num() ? (v.as_intscaled() >> INTSCALED_SHIFT) : 0;
+        return i < 0 ? 0 : std::min((size_t)i, size);
+    }
+
+    bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v'; }
+
+    // sub(s, start, count): indices are clamped to the string
+    Value builtin_sub(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        if (argc < 3 || !is_string(argv[0])) return Value::make_nil();
+        size_t n = value_to_string(argv[0]).size();
+        size_t start = clamp_index(argv[1], n);
+        return string_slice(argv[0], start, clamp_index(argv[2], n - start));
+    }
+
+    Value builtin_trim(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        if (argc < 1 || !is_string(argv[0])) return Value::make_nil();
+        std::string_view s = value_to_string(argv[0]);
+        size_t b = 0, e = s.size();
+        while (b < e && is_space(s[b])) ++b;
+        while (e > b && is_space(s[e - 1])) --e;
+        return string_slice(argv[0], b, e - b);
+    }
+
+    // split(s, sep): a list of the pieces between separators, s alone when sep is empty
+    Value builtin_split(int argc, const Value* argv, [[maybe_unused]] void* ctx) {
+        if (argc < 2 || !is_string(argv[0]) || !is_string(argv[1])) return Value::make_nil();
+        std::string_view s = value_to_string(argv[0]), sep = value_to_string(argv[1]);
+        ObjList* parts = new ObjList();
+        if (sep.empty()) {
+            retain(argv[0]);
+            parts->elements.push_back(argv[0]);
+            return Value::make_obj(parts);
+        }
+        size_t from = 0;
+        for (size_t at; (at = string_find(s, sep, from)) != std::string_view::npos; from = at + sep.size()) {
+            parts->elements.push_back(string_slice(argv[0], from, at - from));
+        }
+        parts->elements.push_back(string_slice(argv[0], from, s.size() - from));
+        return Value::make_obj(parts);
+    }
+
+    int64_t native_find(std::string_view s, std::string_view needle) {
+        size_t at = string_find(s, needle);
+        return at == std::string_view::npos ? -1 : (int64_t)at;
+    }
+    int64_t native_count(std::string_view s, std::string_view needle) { return (int64_t)string_count(s, needle); }
+    bool native_starts_with(std::string_view s, std::string_view prefix) { return s.substr(0, prefix.size()) == prefix; }
+}
+
+void register_string_builtins() {
+    BuiltinRegistry::register_builtin("sub", &builtin_sub, nullptr, TY_STRING, {TY_STRING, TY_NUMBER, TY_NUMBER}, true);
+    BuiltinRegistry::register_builtin("trim", &builtin_trim, nullptr, TY_STRING, {TY_STRING}, true);
+    BuiltinRegistry::register_builtin("split", &builtin_split, nullptr, TY_LIST, {TY_STRING, TY_STRING}, true);
+    register_native<&native_find>("find", true);
+    register_native<&native_count>("count", true);
+    register_native<&native_starts_with>("starts_with", true);
+}
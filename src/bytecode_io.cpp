@@ -13,6 +13,18 @@ static constexpr uint8_t FILE_TAG_STRUCT = 0x11;
 void BytecodeIO::save(const std::string& filename, Assembler& as, bool alsoVisual) {
     std::ofstream out(filename, std::ios::binary);
     if (!out) throw std::runtime_error("It was not possible to create a file " + filename);
+    write(out, as);
+    if (!out) throw std::runtime_error("Write error while saving " + filename);
+    std::cout << "Compiled successfully for " << filename << std::endl;
+
+    if (alsoVisual) {
+        std::string txtfile = filename + ".txt";
+        save_text(txtfile, as);
+        std::cout << "Saved readable dump to " << txtfile << std::endl;
+    }
+}
+
+void BytecodeIO::write(std::ostream& out, Assembler& as) {
     const char magic[] = "MDOT";
     out.write(magic, 4);
 
@@ -34,7 +46,7 @@ void BytecodeIO::save(const std::string& filename, Assembler& as, bool alsoVisua
             Obj* o = v.as_obj();
             if (o->type == OBJ_STRING) {
                 uint8_t tag = TAG_OBJ;
-                std::string s = ((ObjString*)o)->str;
+                std::string s(((ObjString*)o)->view());
                 uint64_t len = static_cast<uint64_t>(s.size());
                 out.write(reinterpret_cast<char*>(&tag), 1);
                 out.write(reinterpret_cast<char*>(&len), sizeof(uint64_t));
@@ -101,19 +113,27 @@ void BytecodeIO::save(const std::string& filename, Assembler& as, bool alsoVisua
     uint64_t n_code = static_cast<uint64_t>(as.code.size());
     out.write(reinterpret_cast<char*>(&n_code), sizeof(uint64_t));
     out.write(reinterpret_cast<const char*>(as.code.data()), n_code * sizeof(Instr));
-    std::cout << "Compiled successfully for " << filename << std::endl;
 
-    if (alsoVisual) {
-        std::string txtfile = filename + ".txt";
-        save_text(txtfile, as);
-        std::cout << "Saved readable dump to " << txtfile << std::endl;
+    // function table, so profiles of a loaded program can name its functions
+    out.write("FUNC", 4);
+    uint32_t n_funcs = static_cast<uint32_t>(as.functions.size());
+    out.write(reinterpret_cast<char*>(&n_funcs), sizeof(uint32_t));
+    for (const FuncInfo& f : as.functions) {
+        uint32_t len = static_cast<uint32_t>(f.name.size());
+        int32_t range[2] = {as.labels[f.entry_label].target_pc, as.labels[f.end_label].target_pc};
+        out.write(reinterpret_cast<char*>(&len), sizeof(uint32_t));
+        out.write(f.name.data(), len);
+        out.write(reinterpret_cast<char*>(range), sizeof range);
     }
 }
 
 void BytecodeIO::load(const std::string& filename, Assembler& as) {
     std::ifstream in(filename, std::ios::binary);
     if (!in) throw std::runtime_error("File not found: " + filename);
+    read(in, as);
+}
 
+void BytecodeIO::read(std::istream& in, Assembler& as) {
     char magic[4];
     in.read(magic, 4);
     if (!in || std::strncmp(magic, "MDOT", 4) != 0)
@@ -241,6 +261,29 @@ void BytecodeIO::load(const std::string& filename, Assembler& as) {
     if (n_code) {
         read_exact(reinterpret_cast<char*>(as.code.data()), static_cast<size_t>(n_code) * sizeof(Instr));
     }
+
+    // files written before the function table existed end here
+    if (in.peek() == std::char_traits<char>::eof()) { in.clear(); return; }
+    char tag[4];
+    read_exact(tag, 4);
+    if (std::strncmp(tag, "FUNC", 4) != 0) throw std::runtime_error("Invalid function table");
+    uint32_t n_funcs;
+    read_exact(reinterpret_cast<char*>(&n_funcs), sizeof(uint32_t));
+    for (uint32_t i = 0; i < n_funcs; ++i) {
+        uint32_t len;
+        read_exact(reinterpret_cast<char*>(&len), sizeof(uint32_t));
+        if (len > (1u << 16)) throw std::runtime_error("Invalid function table");
+        FuncInfo f;
+        f.name.resize(len);
+        read_exact(f.name.data(), len);
+        int32_t range[2];
+        read_exact(reinterpret_cast<char*>(range), sizeof range);
+        f.entry_label = as.make_label();
+        f.end_label = as.make_label();
+        as.labels[f.entry_label].target_pc = range[0];
+        as.labels[f.end_label].target_pc = range[1];
+        as.functions.push_back(f);
+    }
 }
 
 std::string BytecodeIO::escape_string(const std::string& s) {
@@ -289,7 +332,7 @@ void BytecodeIO::save_text(const std::string& filename_txt, Assembler& as) {
         } else if (v.is_obj()) {
             Obj* o = v.as_obj();
             if (o->type == OBJ_STRING)
-                out << "string \"" << escape_string(((ObjString*)o)->str) << "\"";
+                out << "string \"" << escape_string(std::string(((ObjString*)o)->view())) << "\"";
             else if (o->type == OBJ_FUNCTION) {
                 ObjFunction* of = (ObjFunction*)o;
                 out << "function ";
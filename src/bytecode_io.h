@@ -1,10 +1,14 @@
 #pragma once
 #include <string>
+#include <iosfwd>
 #include "assembler.h"
 
 struct BytecodeIO {
     static void save(const std::string& filename, Assembler& as, bool alsoVisual = false);
     static void load(const std::string& filename, Assembler& as);
+    // raw image without the console messages or text dump of save/load
+    static void write(std::ostream& out, Assembler& as);
+    static void read(std::istream& in, Assembler& as);
 
 private:
     static void save_text(const std::string& filename_txt, Assembler& as);
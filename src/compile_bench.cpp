@@ -0,0 +1,67 @@
+#include "compile_bench.h"
+#include "compiler.h"
+#include "source_manager.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace {
+    // one function of `lines` statements, every line reading locals defined far above it
+    std::string one_function_unit(int lines) {
+        std::string s = "unit bench\n{\n    on void main()\n        number v0 = 1\n";
+        int defined = 1;
+        for (int i = 1; i < lines; ++i) {
+            if (i % 4 == 3)
+                s += "        v" + std::to_string(defined / 2) + " = v" + std::to_string(defined / 3) + " * 2\n";
+            else {
+                s += "        number v" + std::to_string(defined) + " = v" + std::to_string(defined / 2) +
+                     " + v" + std::to_string(defined - 1) + "\n";
+                defined++;
+            }
+        }
+        s += "    end\n}\n";
+        return s;
+    }
+
+    // `lines` lines of small functions, overloaded eight ways by arity, each calling into
+    // the group declared before it
+    std::string many_functions_unit(int lines) {
+        std::string s = "unit bench\n{\n";
+        int groups = lines / 8 / 3 + 1;
+        for (int g = 0; g < groups; ++g)
+            for (int arity = 0; arity < 8; ++arity) {
+                std::string params, args;
+                for (int p = 0; p < arity; ++p) {
+                    params += (p ? ", p" : "p") + std::to_string(p) + ": number";
+                    args += (p ? ", p" : "p") + std::to_string(p);
+                }
+                s += "    on number f" + std::to_string(g) + "(" + params + ")\n";
+                s += g ? "        return f" + std::to_string(g - 1) + "(" + args + ") + 1\n" : "        return 1\n";
+                s += "    end\n";
+            }
+        s += "    on void main()\n        print(f" + std::to_string(groups - 1) + "(1, 2))\n    end\n}\n";
+        return s;
+    }
+
+    double compile_seconds(const std::string& source) {
+        CompilerOptions opts;
+        opts.opt_level = 0;
+        auto start = std::chrono::steady_clock::now();
+        SourceManager sm(source, "bench.mon");
+        Compiler comp(source, opts);
+        comp.compile_unit(&sm);
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int run_compile_bench(int max_lines) {
+    struct Shape { const char* name; std::string (*make)(int); };
+    const Shape shapes[] = {{"one function", one_function_unit}, {"many functions", many_functions_unit}};
+    std::printf("%-16s %10s %10s %14s\n", "shape", "lines", "seconds", "lines/s");
+    for (const Shape& shape : shapes)
+        for (int lines = max_lines / 8; lines <= max_lines; lines *= 2) {
+            double t = compile_seconds(shape.make(lines));
+            std::printf("%-16s %10d %10.3f %14.0f\n", shape.name, lines, t, lines / t);
+        }
+    return 0;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// "mondot bench compile [lines]": times the front end on generated units of growing
+// size and prints lines per second, so superlinear phases show up as a falling rate
+int run_compile_bench(int max_lines);
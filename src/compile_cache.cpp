@@ -0,0 +1,221 @@
+#include "compile_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+    constexpr char ENTRY_MAGIC[4] = {'M', 'D', 'C', 'C'};
+    constexpr uint64_t FNV_OFFSET = 1469598103934665603ULL;
+    constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+    constexpr const char* ENTRY_EXT = ".mdcc";
+    constexpr uint64_t EVENT_LOG_LIMIT = 4096;   // folded into the totals beyond this
+
+    uint64_t fnv1a(std::string_view s, uint64_t h = FNV_OFFSET) {
+        for (unsigned char c : s) { h ^= c; h *= FNV_PRIME; }
+        return h;
+    }
+
+    // identifies the compiler build: opcode numbering and passes change between builds
+    std::string build_id() {
+        std::string id = std::string("mondot-cc1 ") + __DATE__ + " " + __TIME__;
+        std::error_code ec;
+        auto size = fs::file_size("/proc/self/exe", ec);
+        if (!ec) { id += ' '; id += std::to_string(size); }
+        auto stamp = fs::last_write_time("/proc/self/exe", ec);
+        if (!ec) { id += ' '; id += std::to_string(stamp.time_since_epoch().count()); }
+        return id;
+    }
+
+    std::string key_material(const CompilerOptions& opts) {
+        static const std::string build = build_id();
+        return build + "|O" + std::to_string(opts.opt_level) + "|I" + std::to_string(opts.max_opt_iters) +
+               "|B" + std::to_string(opts.inline_budget) + "|";
+    }
+
+    std::string temp_name(const std::string& base) {
+        thread_local std::mt19937_64 rng(std::random_device{}() ^
+                                   (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count());
+        std::ostringstream ss;
+        ss << base << ".tmp" << std::hex << rng();
+        return ss.str();
+    }
+
+    // readers only ever see a complete file or none at all
+    bool write_atomically(const std::string& path, const std::string& data) {
+        std::string tmp = temp_name(path);
+        {
+            std::ofstream out(tmp, std::ios::binary);
+            if (!out) return false;
+            out.write(data.data(), (std::streamsize)data.size());
+            if (!out) { out.close(); std::error_code ec; fs::remove(tmp, ec); return false; }
+        }
+        std::error_code ec;
+        fs::rename(tmp, path, ec);
+        if (ec) fs::remove(tmp, ec);
+        return !ec;
+    }
+
+    void read_totals(const std::string& path, uint64_t& hits, uint64_t& misses) {
+        std::ifstream in(path);
+        hits = misses = 0;
+        if (in) in >> hits >> misses;
+    }
+}
+
+CompileCache CompileCache::from_env() {
+    const char* off = std::getenv("MONDOT_CACHE");
+    if (off && std::string(off) == "0") return CompileCache("", 0);
+
+    std::string dir;
+    if (const char* d = std::getenv("MONDOT_CACHE_DIR")) dir = d;
+    else if (const char* x = std::getenv("XDG_CACHE_HOME")) dir = std::string(x) + "/mondot";
+    else if (const char* h = std::getenv("HOME")) dir = std::string(h) + "/.cache/mondot";
+
+    uint64_t max_mb = 64;
+    if (const char* m = std::getenv("MONDOT_CACHE_MAX_MB")) max_mb = std::strtoull(m, nullptr, 10);
+    return CompileCache(dir, max_mb << 20);
+}
+
+CompileCache::CompileCache(const std::string& dir, uint64_t max_bytes) : dir_(dir), max_bytes_(max_bytes) {
+    if (dir_.empty()) return;
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec || !fs::is_directory(dir_, ec)) dir_.clear();
+}
+
+std::string CompileCache::entry_path(uint64_t key) const {
+    std::ostringstream ss;
+    ss << dir_ << "/" << std::hex << key << ENTRY_EXT;
+    return ss.str();
+}
+
+bool CompileCache::load(std::string_view source, const CompilerOptions& opts, const std::string& context, std::string& image) {
+    if (!enabled()) return false;
+    std::string material = key_material(opts) + context;
+    uint64_t key = fnv1a(source, fnv1a(material));
+    std::string path = entry_path(key);
+
+    std::ifstream in(path, std::ios::binary);
+    bool hit = false;
+    if (in) {
+        // the header repeats the key, the source size and a second hash to rule out collisions
+        char magic[4];
+        uint64_t stored_key = 0, size = 0, check = 0;
+        in.read(magic, 4);
+        in.read(reinterpret_cast<char*>(&stored_key), sizeof stored_key);
+        in.read(reinterpret_cast<char*>(&size), sizeof size);
+        in.read(reinterpret_cast<char*>(&check), sizeof check);
+        if (in && std::memcmp(magic, ENTRY_MAGIC, 4) == 0 && stored_key == key &&
+            size == source.size() && check == fnv1a(material, fnv1a(source))) {
+            std::ostringstream rest;
+            rest << in.rdbuf();
+            image = rest.str();
+            hit = true;
+        }
+    }
+    if (hit) {
+        // recency for eviction
+        std::error_code ec;
+        fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    }
+    record(hit ? 'h' : 'm');
+    return hit;
+}
+
+void CompileCache::store(std::string_view source, const CompilerOptions& opts, const std::string& context, const std::string& image) {
+    if (!enabled()) return;
+    std::string material = key_material(opts) + context;
+    uint64_t key = fnv1a(source, fnv1a(material));
+    uint64_t size = source.size(), check = fnv1a(material, fnv1a(source));
+
+    std::string data(ENTRY_MAGIC, 4);
+    data.append(reinterpret_cast<const char*>(&key), sizeof key);
+    data.append(reinterpret_cast<const char*>(&size), sizeof size);
+    data.append(reinterpret_cast<const char*>(&check), sizeof check);
+    data += image;
+    if (!write_atomically(entry_path(key), data)) return;
+    evict();
+}
+
+void CompileCache::record(char event) {
+    std::string log = dir_ + "/events";
+    {
+        // one-byte appends are atomic, so concurrent processes never lose each other's events
+        std::ofstream out(log, std::ios::binary | std::ios::app);
+        if (!out) return;
+        out.put(event);
+    }
+    std::error_code ec;
+    if (fs::file_size(log, ec) < EVENT_LOG_LIMIT || ec) return;
+
+    // whoever wins the rename folds the log into the totals
+    std::string claimed = temp_name(log);
+    fs::rename(log, claimed, ec);
+    if (ec) return;
+    uint64_t hits, misses;
+    read_totals(dir_ + "/totals", hits, misses);
+    std::ifstream in(claimed, std::ios::binary);
+    for (char c; in.get(c);) (c == 'h' ? hits : misses)++;
+    in.close();
+    fs::remove(claimed, ec);
+    write_atomically(dir_ + "/totals", std::to_string(hits) + " " + std::to_string(misses) + "\n");
+}
+
+void CompileCache::evict() {
+    struct Entry { fs::path path; uint64_t size; fs::file_time_type used; };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (const auto& de : fs::directory_iterator(dir_, ec)) {
+        if (de.path().extension() != ENTRY_EXT) continue;
+        std::error_code e2;
+        uint64_t size = de.file_size(e2);
+        auto used = de.last_write_time(e2);
+        if (e2) continue;
+        entries.push_back({de.path(), size, used});
+        total += size;
+    }
+    if (total <= max_bytes_) return;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& x, const Entry& y) { return x.used < y.used; });
+    for (const Entry& e : entries) {
+        if (total <= max_bytes_) break;
+        // another process may have removed it already
+        if (fs::remove(e.path, ec) || !ec) total -= e.size;
+    }
+}
+
+CompileCache::Stats CompileCache::stats() const {
+    Stats s;
+    if (!enabled()) return s;
+    read_totals(dir_ + "/totals", s.hits, s.misses);
+    std::ifstream in(dir_ + "/events", std::ios::binary);
+    for (char c; in.get(c);) (c == 'h' ? s.hits : s.misses)++;
+    std::error_code ec;
+    for (const auto& de : fs::directory_iterator(dir_, ec)) {
+        if (de.path().extension() != ENTRY_EXT) continue;
+        std::error_code e2;
+        uint64_t size = de.file_size(e2);
+        if (e2) continue;
+        s.entries++;
+        s.bytes += size;
+    }
+    return s;
+}
+
+void CompileCache::clear() {
+    if (!enabled()) return;
+    std::error_code ec;
+    std::vector<fs::path> doomed;
+    for (const auto& de : fs::directory_iterator(dir_, ec))
+        if (de.path().extension() == ENTRY_EXT || de.path().filename() == "events" || de.path().filename() == "totals")
+            doomed.push_back(de.path());
+    for (const auto& p : doomed) fs::remove(p, ec);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "compiler.h"
+
+// on-disk bytecode cache for "mondot <file.mon>", keyed by a hash of the source,
+// the compiler build and the CompilerOptions. Entries are written to a temp file and
+// renamed into place, so processes sharing the directory never see a partial entry.
+class CompileCache {
+public:
+    struct Stats { uint64_t hits = 0, misses = 0, entries = 0, bytes = 0; };
+
+    // MONDOT_CACHE_DIR overrides the location, MONDOT_CACHE=0 disables the cache and
+    // MONDOT_CACHE_MAX_MB bounds its size (least recently used entries go first)
+    static CompileCache from_env();
+    CompileCache(const std::string& dir, uint64_t max_bytes);
+
+    bool enabled() const { return !dir_.empty(); }
+    const std::string& dir() const { return dir_; }
+
+    // compiled images of one source; `context` names what else they depend on and is part of the key
+    bool load(std::string_view source, const CompilerOptions& opts, const std::string& context, std::string& image);
+    void store(std::string_view source, const CompilerOptions& opts, const std::string& context, const std::string& image);
+
+    Stats stats() const;
+    void clear();
+
+private:
+    std::string dir_;
+    uint64_t max_bytes_;
+
+    std::string entry_path(uint64_t key) const;
+    void record(char event);
+    void evict();
+};
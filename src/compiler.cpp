@@ -3,14 +3,22 @@
 #include "source_manager.h"
 
 #include "builtin_registry.h"
+#include "profile.h"
 #include "value.h"
+#include <algorithm>
 #include <sstream>
 
-Compiler::Compiler(const std::string& source, const CompilerOptions& opts) : source_text_(source), options(opts) {
+Compiler::Compiler(std::string_view source, const CompilerOptions& opts) : source_text_(source), options(opts) {
     register_builtin_signatures();
     parser_ = new Parser(this, source_text_);
 }
 
+Compiler::Compiler(const Compiler& unit)
+    : options(unit.options), imports(unit.imports), is_library(unit.is_library),
+      function_table_(unit.function_table_), item_types_(unit.item_types_), item_name_to_id_(unit.item_name_to_id_) {
+    parser_ = new Parser(this, *unit.parser_);
+}
+
 Compiler::~Compiler() { delete parser_; }
 
 void Compiler::register_builtin_signatures() {
@@ -22,7 +30,7 @@ void Compiler::register_builtin_signatures() {
         fs.is_builtin = true;
         fs.label_id = -1;
         fs.internal_name = mangle_name(fs.name, fs.param_types);
-        function_table_[fs.name].push_back(fs);
+        function_table_.add(fs);
     }
 }
 
@@ -35,22 +43,42 @@ std::string Compiler::mangle_name(const std::string &name, const std::vector<Typ
 
 void Compiler::compile_unit(SourceManager* sm) {
     parser_->compile_unit(sm);
+    if (options.opt_level >= 2)
+        asm_.inline_small_functions(options.inline_budget, profile ? profile_inline_budgets() : std::vector<int>{});
     if (options.opt_level > 0)
         asm_.run_optimizations(options.opt_level, options.max_opt_iters);
 }
 
+// callees among the hottest get four times the budget, callees that never ran are left alone
+std::vector<int> Compiler::profile_inline_budgets() const {
+    std::vector<FuncInfo> scoped = asm_.functions;
+    for (FuncInfo& f : scoped) f.name = profile_scope + f.name;
+    std::vector<std::string> keys = function_keys(scoped);
+    uint64_t hottest = 0;
+    for (const std::string& k : keys) {
+        auto it = profile->functions.find(k);
+        if (it != profile->functions.end()) hottest = std::max(hottest, it->second.calls);
+    }
+    std::vector<int> budgets;
+    for (const std::string& k : keys) {
+        auto it = profile->functions.find(k);
+        if (it == profile->functions.end()) budgets.push_back(options.inline_budget);
+        else if (it->second.calls == 0) budgets.push_back(0);
+        else if (it->second.calls * 16 >= hottest) budgets.push_back(options.inline_budget * 4);
+        else budgets.push_back(options.inline_budget);
+    }
+    return budgets;
+}
+
 void Compiler::push_diag(const std::string &m, SourceLocation loc, const std::string &fn) {
     diagnostics_.push_back({m, loc, fn});
 }
 
 int Compiler::resolve_local(const std::string& name) {
-    for (int i = (int)locals_.size() - 1; i >= 0; --i) if (locals_[i].name == name) return locals_[i].slot;
-    return -1;
+    return locals_.resolve(name);
 }
 int Compiler::define_local(const std::string& name, TypeKind t, int user_type_id) {
-    int slot = (int)locals_.size();
-    locals_.push_back({name, scope_depth_, slot, t, user_type_id});
-    return slot;
+    return locals_.define(name, scope_depth_, t, user_type_id);
 }
 
 int Compiler::emit_const(Value v, int line) {
@@ -63,7 +91,7 @@ int Compiler::emit_const(Value v, int line) {
 void Compiler::begin_scope() { scope_depth_++; }
 void Compiler::end_scope() {
     scope_depth_--;
-    while (!locals_.empty() && locals_.back().depth > scope_depth_) locals_.pop_back();
+    locals_.pop_scope(scope_depth_);
 }
 
 std::string Compiler::type_kind_to_string(TypeKind t) {
@@ -75,13 +103,13 @@ std::string Compiler::type_kind_to_string(TypeKind t) {
         case TY_LIST:   return "list";
         case TY_ITEM:   return "item";
         case TY_TABLE:  return "table";
+        case TY_FILE:   return "file";
         case TY_UNKNOWN: return "unknown";
         default: return "unknown";
     }
 }
 
 int Compiler::register_item_type(const std::string &name, const std::string &parent_name, const std::vector<std::pair<std::string, TypeKind>>& fields) {
-    static int next_id = 0;
     auto itdup = item_name_to_id_.find(name);
     if (itdup != item_name_to_id_.end()) {
         push_diag(std::string("Duplicate item type: ") + name, {0,0,0}, "");
@@ -98,7 +126,8 @@ int Compiler::register_item_type(const std::string &name, const std::string &par
         }
     }
 
-    int id = next_id++;
+    // ids index item_types_, so they are per compiler
+    int id = (int)item_types_.size();
     ItemType itp;
     itp.id = id;
     itp.name = name;
@@ -122,7 +151,7 @@ int Compiler::register_item_type(const std::string &name, const std::string &par
     fs.is_builtin = false;
     for (auto &f : itp.fields) fs.param_types.push_back(f.second);
     fs.internal_name = mangle_name(fs.name, fs.param_types);
-    function_table_[fs.name].push_back(fs);
+    function_table_.add(fs);
 
     return id;
 }
@@ -140,11 +169,13 @@ const std::vector<std::pair<std::string, TypeKind>>& Compiler::get_item_fields(i
 }
 
 FunctionSig* Compiler::resolve_function(const std::string &name, const std::vector<TypeKind> &arg_types) {
-    auto it = function_table_.find(name);
-    if (it == function_table_.end()) return nullptr;
+    Overloads* o = function_table_.find(name);
+    if (!o) return nullptr;
+    auto cands = o->by_arity.find(arg_types.size());
+    if (cands == o->by_arity.end() || cands->second.empty()) return nullptr;
     FunctionSig* best = nullptr;
-    for (auto &fs : it->second) {
-        if ((int)fs.param_types.size() != (int)arg_types.size()) continue;
+    for (int i : cands->second) {
+        FunctionSig& fs = o->sigs[i];
         bool ok = true;
         for (int i = 0; i < (int)arg_types.size(); ++i) {
             if (arg_types[i] == TY_UNKNOWN) continue;
@@ -156,8 +187,5 @@ FunctionSig* Compiler::resolve_function(const std::string &name, const std::vect
     }
     if (best) return best;
     // return any overload with same arity as fallback if none matched by type
-    for (auto &fs : it->second) {
-        if ((int)fs.param_types.size() == (int)arg_types.size()) return &fs;
-    }
-    return nullptr;
+    return &o->sigs[cands->second.front()];
 }
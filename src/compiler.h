@@ -7,29 +7,41 @@
 #include "assembler.h"
 #include "source_manager.h"
 #include "value.h"
+#include "symbol_table.h"
 
 struct Diagnostic { std::string msg; SourceLocation loc; std::string func; };
 
+// every field is part of the compile cache key (compile_cache.cpp)
 struct CompilerOptions {
     // 0 = no optimizations, 1 = basic, 2 = aggressive, higher = iterative
     int opt_level = 2;
     // maximum number of optimization iterations when iterating to fixpoint
     int max_opt_iters = 8;
+    // largest callee (in reachable instructions) spliced into its callers, 0 disables inlining
+    int inline_budget = 16;
 };
 
-struct FunctionSig {
+// a function other units may call, numbered by definition order in its unit
+struct ExportSig {
     std::string name;
-    std::string internal_name;
     std::vector<TypeKind> param_types;
     TypeKind return_type = TY_VOID;
-    int user_return_type_id = -1;
-    int label_id = -1;
-    int declared_line = 0;
-    bool is_builtin = false;
 };
 
-struct LocalEntry { std::string name; int depth; int slot; TypeKind type; int user_type_id; };
+// a dependency named in the unit header, callable as alias.fn(...)
+struct ImportedUnit {
+    std::string unit;
+    std::vector<ExportSig> exports;
+};
+
+// target of an OP_CALL into another unit, resolved by the linker (see import_call_ref)
+struct ImportCall {
+    std::string unit;
+    int export_index;
+};
+
 class Parser;
+struct Profile;
 
 class RegAllocator {
     int next_reg_ = 0;
@@ -46,10 +58,14 @@ public:
 class Compiler {
 public:
     Assembler asm_;
-    Compiler(const std::string& source, const CompilerOptions& opts = {});
+    // `source` is not copied and must outlive the compiler
+    Compiler(std::string_view source, const CompilerOptions& opts = {});
+    // worker for a unit's function bodies: same tables and tokens, its own Assembler
+    explicit Compiler(const Compiler& unit);
     ~Compiler();
 
     void compile_unit(SourceManager* sm);
+    const std::vector<OptRemark>& remarks() const { return asm_.remarks; }
 
     void push_diag(const std::string &m, SourceLocation loc, const std::string &fn = "");
     int resolve_local(const std::string& name);
@@ -64,14 +80,25 @@ public:
     // options
     CompilerOptions options;
 
+    // multi-unit builds (linker.h): dependencies by alias, and whether the unit is a library
+    // without an entry point. import_calls is filled while compiling.
+    std::map<std::string, ImportedUnit> imports;
+    bool is_library = false;
+    std::vector<ImportCall> import_calls;
+
+    // a run of the linked program (profile.h) steers inlining; its function keys carry
+    // profile_scope ("unit." in multi-unit programs) in front of this unit's names
+    const Profile* profile = nullptr;
+    std::string profile_scope;
+
 private:
     friend class Parser;
     Parser* parser_ = nullptr;
 
-    std::string source_text_;
-    std::vector<LocalEntry> locals_;
+    std::string_view source_text_;
+    LocalTable locals_;
     int scope_depth_ = 0;
-    std::map<std::string, std::vector<FunctionSig>> function_table_;
+    FunctionTable function_table_;
     std::vector<Diagnostic> diagnostics_;
     std::string current_function_;
     TypeKind expected_return_ = TY_UNKNOWN;
@@ -89,4 +116,5 @@ private:
     RegAllocator regalloc_;
     std::string mangle_name(const std::string &name, const std::vector<TypeKind>& types);
     void register_builtin_signatures();
+    std::vector<int> profile_inline_budgets() const;
 };
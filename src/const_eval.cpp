@@ -0,0 +1,116 @@
+#include "assembler.h"
+#include "builtin_registry.h"
+#include "dataflow.h"
+#include "vm.h"
+#include <algorithm>
+#include <map>
+#include <memory>
+
+namespace {
+    // instructions one compile-time call may take before it is left to run time
+    constexpr uint64_t EVAL_STEP_BUDGET = 100000;
+
+    // constants can hold scalars and strings, never a container someone could mutate
+    bool embeddable(const Value& v) {
+        return !v.is_obj() || v.as_obj()->type == OBJ_STRING;
+    }
+}
+
+// parameters sit in registers 0 .. arity-1, arity being the argument count of the call sites
+std::vector<char> Assembler::pure_functions() const {
+    int n = (int)code.size();
+    std::map<int, int> func_at;
+    std::vector<std::pair<int, int>> body(functions.size(), {0, 0});
+    for (size_t f = 0; f < functions.size(); ++f) {
+        int s = labels[functions[f].entry_label].target_pc, e = std::min(labels[functions[f].end_label].target_pc, n);
+        if (s < 0 || e <= s) continue;
+        body[f] = {s, e};
+        func_at[s] = (int)f;
+    }
+
+    std::vector<int> arity(functions.size(), 0);
+    for (const Instr& ins : code) {
+        if (!op_calls_pc(ins.op)) continue;
+        auto it = func_at.find(ins.b);
+        if (it != func_at.end()) arity[it->second] = std::max(arity[it->second], ins.c);
+    }
+
+    std::vector<char> pure(functions.size(), 0);
+    std::vector<std::vector<int>> callees(functions.size());
+    for (size_t f = 0; f < functions.size(); ++f) {
+        if (body[f].second <= body[f].first) continue;
+        bool ok = true;
+        for (int pc = body[f].first; pc < body[f].second && ok; ++pc) {
+            const Instr& ins = code[pc];
+            if (op_calls_pc(ins.op)) {
+                auto it = func_at.find(ins.b);
+                if (it == func_at.end()) ok = false;
+                else callees[f].push_back(it->second);
+            } else if (ins.op == OP_CONST) {
+                const Value& v = constants[ins.b];
+                if (v.is_obj() && v.as_obj()->type == OBJ_FUNCTION) {
+                    const BuiltinEntry* be = BuiltinRegistry::get_entry(((ObjFunction*)v.as_obj())->builtin_id);
+                    ok = be && be->pure;
+                }
+            } else if (op_may_replace_a(ins.op) && ins.a < arity[f]) {
+                ok = false;
+            }
+        }
+        pure[f] = ok;
+    }
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t f = 0; f < functions.size(); ++f)
+            for (int c : callees[f])
+                if (pure[f] && !pure[c]) { pure[f] = 0; changed = true; }
+    }
+    return pure;
+}
+
+// calls to pure functions whose arguments are all known constants run in a sandboxed VM
+// and become the constant they return
+bool Assembler::pass_evaluate_pure_calls() {
+    if (functions.empty()) return false;
+    std::vector<char> pure = pure_functions();
+    std::map<int, int> func_at;   // entry pc of each pure function
+    for (size_t f = 0; f < functions.size(); ++f)
+        if (pure[f]) func_at[labels[functions[f].entry_label].target_pc] = (int)f;
+    if (func_at.empty()) return false;
+
+    ControlFlow cfg; cfg.build(*this);
+    ReachingConsts rc; rc.compute(code, cfg, max_register(code, 0, (int)code.size()) + 1);
+    std::unique_ptr<VM> sandbox;   // the code as it was when the pass started, made on first use
+    bool changed = false;
+
+    for (int b = 0; b < (int)cfg.start.size(); ++b) {
+        std::vector<int> st = rc.in[b];
+        for (int i = cfg.start[b]; i < cfg.end(b); ++i) {
+            Instr& ins = code[i];
+            auto callee = op_calls_pc(ins.op) ? func_at.find(ins.b) : func_at.end();
+            if (callee != func_at.end()) {
+                std::vector<Value> args;
+                for (int k = 0; k < ins.c; ++k) {
+                    int r = ins.a + 1 + k;
+                    if (r >= (int)st.size() || st[r] < 0 || !embeddable(constants[st[r]])) break;
+                    args.push_back(constants[st[r]]);
+                }
+                Value result = Value::make_nil();
+                if ((int)args.size() == ins.c) {
+                    if (!sandbox) sandbox = std::make_unique<VM>(*this);
+                    if (sandbox->call_pure(ins.b, args, EVAL_STEP_BUDGET, result)) {
+                        if (embeddable(result)) {
+                            remarks.push_back({"const-eval", ins.line, "call to '" + functions[callee->second].name +
+                                               "' evaluated at compile time"});
+                            ins = {OP_CONST, ins.a, add_constant(result), 0, ins.line};
+                            changed = true;
+                        }
+                        release(result);
+                    }
+                }
+            }
+            step_consts(ins, st);
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,255 @@
+#include "dataflow.h"
+#include <algorithm>
+
+void instr_uses(const Instr& ins, std::vector<int>& out) {
+    out.clear();
+    unsigned regs = reg_operands(ins.op);
+    if ((regs & OPND_A) && !op_writes_a(ins.op)) out.push_back(ins.a);
+    if (regs & OPND_B) out.push_back(ins.b);
+    if (regs & OPND_C) out.push_back(ins.c);
+    for (int i = 0; i < call_arg_count(ins); ++i) out.push_back(ins.a + 1 + i);
+}
+
+int max_register(const std::vector<Instr>& code, int from, int to) {
+    int m = -1;
+    for (int pc = from; pc < to; ++pc) {
+        const Instr& ins = code[pc];
+        unsigned regs = reg_operands(ins.op);
+        if (regs & OPND_A) m = std::max(m, ins.a + call_arg_count(ins));
+        if (regs & OPND_B) m = std::max(m, ins.b);
+        if (regs & OPND_C) m = std::max(m, ins.c);
+    }
+    return m;
+}
+
+void ControlFlow::build(const Assembler& as) {
+    const auto& code = as.code;
+    code_size = (int)code.size();
+    std::vector<char> leader(code_size + 1, 0);
+    if (code_size > 0) leader[0] = 1;
+    for (const auto& lab : as.labels)
+        if (lab.target_pc >= 0 && lab.target_pc < code_size) leader[lab.target_pc] = 1;
+    for (int pc = 0; pc < code_size; ++pc) {
+        const Instr& ins = code[pc];
+        if (op_has_pc_target(ins.op) && ins.b >= 0 && ins.b < code_size) leader[ins.b] = 1;
+        if (ins.op == OP_JMP || op_is_cond_jump(ins.op) || ins.op == OP_RETURN) leader[pc + 1] = 1;
+    }
+
+    start.clear();
+    block_of.assign(code_size, 0);
+    for (int pc = 0; pc < code_size; ++pc) {
+        if (leader[pc]) start.push_back(pc);
+        block_of[pc] = (int)start.size() - 1;
+    }
+
+    int nb = (int)start.size();
+    succ.assign(nb, {});
+    pred.assign(nb, {});
+    for (int b = 0; b < nb; ++b) {
+        const Instr& last = code[end(b) - 1];
+        auto link = [&](int pc) {
+            if (pc < 0 || pc >= code_size) return;
+            int t = block_of[pc];
+            succ[b].push_back(t);
+            pred[t].push_back(b);
+        };
+        if (last.op == OP_RETURN) continue;
+        if (last.op == OP_JMP) { link(last.b); continue; }
+        if (op_is_cond_jump(last.op)) link(last.b);
+        link(end(b));
+    }
+
+    entry.assign(nb, 0);
+    for (int b = 0; b < nb; ++b) if (pred[b].empty()) entry[b] = 1;
+    for (const auto& ins : code)
+        if (op_calls_pc(ins.op) && ins.b >= 0 && ins.b < code_size) entry[block_of[ins.b]] = 1;
+}
+
+void Liveness::compute(const std::vector<Instr>& code, const ControlFlow& cfg) {
+    nregs = max_register(code, 0, (int)code.size()) + 1;
+    int nb = (int)cfg.start.size();
+    std::vector<RegSet> use(nb), def(nb);
+    in.assign(nb, {});
+    out.assign(nb, {});
+    std::vector<int> uses;
+    for (int b = 0; b < nb; ++b) {
+        use[b].resize(nregs); def[b].resize(nregs);
+        in[b].resize(nregs); out[b].resize(nregs);
+        for (int pc = cfg.start[b]; pc < cfg.end(b); ++pc) {
+            instr_uses(code[pc], uses);
+            for (int r : uses) if (!def[b].test(r)) use[b].set(r);
+            def[b].set(instr_def(code[pc]));
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = nb - 1; b >= 0; --b) {
+            for (int s : cfg.succ[b]) out[b].merge(in[s]);
+            RegSet n = out[b];
+            for (size_t w = 0; w < n.bits.size(); ++w) n.bits[w] = (n.bits[w] & ~def[b].bits[w]) | use[b].bits[w];
+            if (n.bits != in[b].bits) { in[b] = std::move(n); changed = true; }
+        }
+    }
+}
+
+void Liveness::live_after(const std::vector<Instr>& code, const ControlFlow& cfg, int b, std::vector<RegSet>& after) const {
+    int s = cfg.start[b], e = cfg.end(b);
+    after.assign(e - s, {});
+    RegSet live = out[b];
+    std::vector<int> uses;
+    for (int pc = e - 1; pc >= s; --pc) {
+        after[pc - s] = live;
+        live.reset(instr_def(code[pc]));
+        instr_uses(code[pc], uses);
+        for (int r : uses) live.set(r);
+    }
+}
+
+void step_consts(const Instr& ins, std::vector<int>& st) {
+    int d = op_may_replace_a(ins.op) ? ins.a : instr_def(ins);
+    if (d < 0 || d >= (int)st.size()) return;
+    if (ins.op == OP_CONST) st[d] = ins.b;
+    else if (ins.op == OP_MOVE && ins.b >= 0 && ins.b < (int)st.size()) st[d] = st[ins.b];
+    else st[d] = -1;
+}
+
+namespace {
+    constexpr int CONST_TOP = -2;  // not reached yet
+}
+
+void ReachingConsts::compute(const std::vector<Instr>& code, const ControlFlow& cfg, int nregs) {
+    int nb = (int)cfg.start.size();
+    in.assign(nb, std::vector<int>(nregs, CONST_TOP));
+    std::vector<std::vector<int>> out(nb, std::vector<int>(nregs, CONST_TOP));
+
+    // entries start unknown
+    const auto& entry = cfg.entry;
+    for (int b = 0; b < nb; ++b)
+        if (entry[b]) std::fill(in[b].begin(), in[b].end(), -1);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = 0; b < nb; ++b) {
+            if (!entry[b]) {
+                for (int r = 0; r < nregs; ++r) {
+                    int v = CONST_TOP;
+                    for (int p : cfg.pred[b]) {
+                        int pv = out[p][r];
+                        if (pv == CONST_TOP) continue;
+                        if (v == CONST_TOP) v = pv;
+                        else if (v != pv) { v = -1; break; }
+                    }
+                    in[b][r] = v;
+                }
+            }
+            std::vector<int> st = in[b];
+            for (int pc = cfg.start[b]; pc < cfg.end(b); ++pc) step_consts(code[pc], st);
+            if (st != out[b]) { out[b] = std::move(st); changed = true; }
+        }
+    }
+    for (auto& st : in) for (int& v : st) if (v == CONST_TOP) v = -1;
+}
+
+std::vector<int> ReachingConsts::at(const std::vector<Instr>& code, const ControlFlow& cfg, int pc) const {
+    int b = cfg.block_of[pc];
+    std::vector<int> st = in[b];
+    for (int p = cfg.start[b]; p < pc; ++p) step_consts(code[p], st);
+    return st;
+}
+
+void RegKinds::step(const Instr& ins, const std::vector<Value>& constants, std::vector<int>& st) {
+    auto at = [&](int r) { return (r >= 0 && r < (int)st.size()) ? st[r] : KIND_UNKNOWN; };
+    int d = op_may_replace_a(ins.op) ? ins.a : instr_def(ins);
+    if (d < 0 || d >= (int)st.size()) return;
+    int k = KIND_UNKNOWN;
+    switch (ins.op) {
+        case OP_CONST:
+            if (constants[ins.b].is_num()) k = KIND_NUMBER;
+            else if (!constants[ins.b].is_obj()) k = KIND_SCALAR;
+            break;
+        case OP_MOVE: case OP_MOVE_S: k = at(ins.b); break;
+        // typed arithmetic always gives a number, the rest nil, a bool or a number
+        case OP_ADD_NN: case OP_SUB_NN: case OP_MUL_NN: case OP_DIV_POW2: k = KIND_NUMBER; break;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_DIV_NN:
+        case OP_LT: case OP_GT: case OP_EQ: case OP_LT_NN: case OP_GT_NN:
+            k = KIND_SCALAR;
+            break;
+        case OP_LIST_NEW: case OP_LIST_PUSH: case OP_LIST_SET: k = KIND_LIST; break;
+        case OP_VEC_ADD: case OP_VEC_SUB: case OP_VEC_MUL: case OP_VEC_DIV: k = KIND_LIST; break;
+        case OP_LIST_LEN: k = (at(ins.b) == KIND_LIST) ? KIND_NUMBER : KIND_SCALAR; break;
+        case OP_STRUCT_NEW: k = KIND_ITEM + std::max(ins.c, 0); break;
+        case OP_STRUCT_SET: {
+            int cur = at(ins.a);
+            int fields = kind_is_item(cur) ? cur - KIND_ITEM : 0;
+            k = KIND_ITEM + std::max(fields, ins.b + 1);
+            break;
+        }
+        default: break;
+    }
+    st[d] = k;
+}
+
+void RegKinds::compute(const std::vector<Instr>& code, const std::vector<Value>& constants, const ControlFlow& cfg, int nregs) {
+    int nb = (int)cfg.start.size();
+    in.assign(nb, std::vector<int>(nregs, KIND_TOP));
+    std::vector<std::vector<int>> out(nb, std::vector<int>(nregs, KIND_TOP));
+    for (int b = 0; b < nb; ++b) if (cfg.entry[b]) std::fill(in[b].begin(), in[b].end(), KIND_UNKNOWN);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b = 0; b < nb; ++b) {
+            if (!cfg.entry[b]) {
+                for (int r = 0; r < nregs; ++r) {
+                    int v = KIND_TOP;
+                    for (int p : cfg.pred[b]) {
+                        int pv = out[p][r];
+                        if (pv == KIND_TOP || pv == v) continue;
+                        if (v == KIND_TOP) v = pv;
+                        // items of one shape with different known sizes keep the smaller one
+                        else if (kind_is_item(v) && kind_is_item(pv)) v = std::min(v, pv);
+                        else if (kind_is_scalar(v) && kind_is_scalar(pv)) v = KIND_SCALAR;
+                        else { v = KIND_UNKNOWN; break; }
+                    }
+                    in[b][r] = v;
+                }
+            }
+            std::vector<int> st = in[b];
+            for (int pc = cfg.start[b]; pc < cfg.end(b); ++pc) step(code[pc], constants, st);
+            if (st != out[b]) { out[b] = std::move(st); changed = true; }
+        }
+    }
+}
+
+std::vector<Loop> find_loops(const ControlFlow& cfg) {
+    int nb = (int)cfg.start.size();
+    // header block -> furthest block jumping back to it
+    std::vector<int> latch(nb, -1);
+    for (int u = 0; u < nb; ++u)
+        for (int h : cfg.succ[u])
+            if (h <= u) latch[h] = std::max(latch[h], u);
+
+    std::vector<Loop> loops;
+    for (int h = 0; h < nb; ++h) {
+        int u = latch[h];
+        if (u < 0) continue;
+        // body must be exactly the contiguous block range, and only the header may be
+        // entered from outside of it
+        bool ok = true;
+        for (int b = h + 1; b <= u && ok; ++b)
+            for (int p : cfg.pred[b]) if (p < h || p > u) { ok = false; break; }
+        if (!ok) continue;
+        Loop L;
+        L.header = h;
+        L.first_pc = cfg.start[h];
+        L.last_pc = cfg.end(u) - 1;
+        loops.push_back(L);
+    }
+    std::sort(loops.begin(), loops.end(), [](const Loop& x, const Loop& y) {
+        return (x.last_pc - x.first_pc) < (y.last_pc - y.first_pc);
+    });
+    return loops;
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "assembler.h"
+
+// registers read by an instruction, including the implicit call argument window
+void instr_uses(const Instr& ins, std::vector<int>& out);
+// register written by an instruction, -1 when none
+inline int instr_def(const Instr& ins) { return op_writes_a(ins.op) ? ins.a : -1; }
+// highest register touched in [from, to), -1 when none
+int max_register(const std::vector<Instr>& code, int from, int to);
+
+struct RegSet {
+    std::vector<uint64_t> bits;
+
+    void resize(int nregs) { bits.assign((nregs + 63) / 64, 0); }
+    bool test(int r) const { return r >= 0 && (size_t)(r >> 6) < bits.size() && ((bits[r >> 6] >> (r & 63)) & 1); }
+    void set(int r) { if (r >= 0 && (size_t)(r >> 6) < bits.size()) bits[r >> 6] |= 1ULL << (r & 63); }
+    void reset(int r) { if (r >= 0 && (size_t)(r >> 6) < bits.size()) bits[r >> 6] &= ~(1ULL << (r & 63)); }
+    bool merge(const RegSet& o) {
+        bool changed = false;
+        for (size_t i = 0; i < bits.size() && i < o.bits.size(); ++i) {
+            uint64_t n = bits[i] | o.bits[i];
+            if (n != bits[i]) { bits[i] = n; changed = true; }
+        }
+        return changed;
+    }
+};
+
+// basic blocks over the whole code vector; calls fall through, returns end a path
+struct ControlFlow {
+    std::vector<int> start;        // first pc of each block
+    std::vector<int> block_of;     // pc -> block
+    std::vector<std::vector<int>> succ, pred;
+    std::vector<char> entry;       // unit stub, call targets and anything else without predecessors
+    int code_size = 0;
+
+    void build(const Assembler& as);
+    int end(int b) const { return (b + 1 < (int)start.size()) ? start[b + 1] : code_size; }
+    bool is_leader(int pc) const { return pc >= 0 && pc < code_size && start[block_of[pc]] == pc; }
+};
+
+struct Liveness {
+    int nregs = 0;
+    std::vector<RegSet> in, out;   // per block
+
+    void compute(const std::vector<Instr>& code, const ControlFlow& cfg);
+    // live registers right after each instruction of block b, indexed by pc - cfg.start[b]
+    void live_after(const std::vector<Instr>& code, const ControlFlow& cfg, int b, std::vector<RegSet>& after) const;
+};
+
+// constant-pool index held by every register on entry to each block (-1 = not a known constant)
+struct ReachingConsts {
+    std::vector<std::vector<int>> in;
+
+    void compute(const std::vector<Instr>& code, const ControlFlow& cfg, int nregs);
+    // state right before pc
+    std::vector<int> at(const std::vector<Instr>& code, const ControlFlow& cfg, int pc) const;
+};
+
+// advances a reaching-constants state over one instruction
+void step_consts(const Instr& ins, std::vector<int>& state);
+
+// what each register is known to hold on entry to each block
+enum : int {
+    KIND_TOP = -2,       // not reached yet
+    KIND_UNKNOWN = -1,
+    KIND_NUMBER = 1,
+    KIND_SCALAR = 2,     // never an object: nil, bool or number
+    KIND_LIST = 3,
+    KIND_ITEM = 16,      // + known field count
+};
+inline bool kind_is_item(int k) { return k >= KIND_ITEM; }
+inline bool kind_is_scalar(int k) { return k == KIND_NUMBER || k == KIND_SCALAR; }
+
+struct RegKinds {
+    std::vector<std::vector<int>> in;
+
+    void compute(const std::vector<Instr>& code, const std::vector<Value>& constants, const ControlFlow& cfg, int nregs);
+    static void step(const Instr& ins, const std::vector<Value>& constants, std::vector<int>& state);
+};
+
+// natural loop laid out contiguously, entered only through its header
+struct Loop {
+    int header = -1;               // block
+    int first_pc = 0, last_pc = 0; // inclusive pc range of the body
+};
+
+// innermost loops first
+std::vector<Loop> find_loops(const ControlFlow& cfg);
@@ -0,0 +1,203 @@
+#include "assembler.h"
+#include "dataflow.h"
+
+namespace {
+    // which registers may / must hold the object allocated at one site
+    struct SiteHolders {
+        std::vector<std::vector<char>> may_in, must_in;   // per block
+
+        static void step(const Instr& ins, int pc, int site, std::vector<char>& may, std::vector<char>& must) {
+            if (pc == site) { may[ins.a] = must[ins.a] = 1; return; }
+            if (ins.op == OP_MOVE) { may[ins.a] = may[ins.b]; must[ins.a] = must[ins.b]; return; }
+            // container stores keep a container of the right type in place
+            if (op_may_replace_a(ins.op)) return;
+            int d = instr_def(ins);
+            if (d >= 0) may[d] = must[d] = 0;
+        }
+
+        void compute(const std::vector<Instr>& code, const ControlFlow& cfg, int nregs, int site) {
+            int nb = (int)cfg.start.size();
+            const auto& entry = cfg.entry;
+
+            may_in.assign(nb, std::vector<char>(nregs, 0));
+            must_in.assign(nb, std::vector<char>(nregs, 1));
+            std::vector<std::vector<char>> may_out(nb, std::vector<char>(nregs, 0));
+            std::vector<std::vector<char>> must_out(nb, std::vector<char>(nregs, 1));
+            std::vector<char> seen(nb, 0);
+            for (int b = 0; b < nb; ++b) if (entry[b]) std::fill(must_in[b].begin(), must_in[b].end(), 0);
+
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (int b = 0; b < nb; ++b) {
+                    if (!entry[b]) {
+                        bool any = false;
+                        for (int p : cfg.pred[b]) {
+                            if (!seen[p]) continue;
+                            if (!any) { may_in[b] = may_out[p]; must_in[b] = must_out[p]; any = true; continue; }
+                            for (int r = 0; r < nregs; ++r) {
+                                may_in[b][r] |= may_out[p][r];
+                                must_in[b][r] &= must_out[p][r];
+                            }
+                        }
+                        if (!any) continue;
+                    }
+                    std::vector<char> may = may_in[b], must = must_in[b];
+                    for (int pc = cfg.start[b]; pc < cfg.end(b); ++pc) step(code[pc], pc, site, may, must);
+                    if (!seen[b] || may != may_out[b] || must != must_out[b]) {
+                        may_out[b] = std::move(may); must_out[b] = std::move(must);
+                        seen[b] = 1; changed = true;
+                    }
+                }
+            }
+        }
+    };
+
+    int64_t const_index(const std::vector<Value>& constants, const std::vector<int>& st, int r) {
+        if (r < 0 || r >= (int)st.size() || st[r] < 0 || !constants[st[r]].is_num()) return -1;
+        return constants[st[r]].as_intscaled() >> INTSCALED_SHIFT;
+    }
+}
+
+// items and short lists that never leave their function live in registers instead of the heap
+bool Assembler::pass_scalar_replace() {
+    bool changed = false;
+    for (int site = 0; site < (int)code.size(); ++site) {
+        const Instr alloc = code[site];
+        if (alloc.op != OP_STRUCT_NEW && alloc.op != OP_LIST_NEW) continue;
+        bool is_list = alloc.op == OP_LIST_NEW;
+
+        int ceiling = function_register_ceiling(site);
+        if (ceiling < 0) continue;
+
+        ControlFlow cfg; cfg.build(*this);
+        int nregs = max_register(code, 0, (int)code.size()) + 1;
+        SiteHolders h; h.compute(code, cfg, nregs, site);
+        ReachingConsts rc; rc.compute(code, cfg, nregs);
+
+        // one register set stands for one object at a time: when the site runs again (in a
+        // loop), nothing may still refer to the previous object
+        {
+            int sb = cfg.block_of[site];
+            std::vector<char> may = h.may_in[sb], must = h.must_in[sb];
+            for (int pc = cfg.start[sb]; pc < site; ++pc) SiteHolders::step(code[pc], pc, site, may, must);
+            Liveness live; live.compute(code, cfg);
+            std::vector<RegSet> after;
+            live.live_after(code, cfg, sb, after);
+            bool stale = false;
+            for (int r = 0; r < nregs && !stale; ++r)
+                stale = may[r] && r != alloc.a && after[site - cfg.start[sb]].test(r);
+            if (stale) continue;
+        }
+
+        int fields = is_list ? 0 : alloc.c;
+        bool sealed = false;       // a list stops growing at its first non-push use
+        bool escapes = false;
+        std::vector<int> uses;
+        for (int b = 0; b < (int)cfg.start.size() && !escapes; ++b) {
+            std::vector<char> may = h.may_in[b], must = h.must_in[b];
+            std::vector<int> st = rc.in[b];
+            for (int pc = cfg.start[b]; pc < cfg.end(b) && !escapes; ++pc) {
+                const Instr& ins = code[pc];
+                instr_uses(ins, uses);
+                bool touches = false;
+                for (int r : uses) {
+                    if (!may[r]) continue;
+                    if (!must[r]) { escapes = true; break; }
+                    touches = true;
+                }
+                if (touches && !escapes) {
+                    auto holds = [&](int r) { return r >= 0 && r < nregs && must[r]; };
+                    switch (ins.op) {
+                        case OP_MOVE:
+                            break;
+                        case OP_STRUCT_SET:
+                            escapes = is_list || holds(ins.c) || ins.b < 0 || ins.b >= fields;
+                            break;
+                        case OP_STRUCT_GET: case OP_FIELD_GET_ITEM:
+                            escapes = is_list || ins.c < 0 || ins.c >= fields;
+                            break;
+                        case OP_LIST_PUSH:
+                            escapes = !is_list || holds(ins.b) || sealed || cfg.block_of[pc] != cfg.block_of[site] || pc < site;
+                            if (!escapes) fields++;
+                            break;
+                        case OP_LIST_GET: case OP_LIST_GET_L: {
+                            int64_t idx = const_index(constants, st, ins.c);
+                            escapes = !is_list || holds(ins.c) || idx < 0 || idx >= fields;
+                            sealed = true;
+                            break;
+                        }
+                        case OP_LIST_SET: {
+                            int64_t idx = const_index(constants, st, ins.b);
+                            escapes = !is_list || holds(ins.b) || holds(ins.c) || idx < 0 || idx >= fields;
+                            sealed = true;
+                            break;
+                        }
+                        case OP_LIST_LEN:
+                            escapes = !is_list;
+                            sealed = true;
+                            break;
+                        default:
+                            escapes = true;
+                            break;
+                    }
+                }
+                SiteHolders::step(ins, pc, site, may, must);
+                step_consts(ins, st);
+            }
+        }
+        if (escapes || ceiling + fields > MAX_FRAME_REGS) continue;
+
+        // rewrite every access against the registers ceiling .. ceiling + fields - 1
+        int nil_const = add_constant(Value::make_nil());
+        std::vector<char> removed(code.size(), 0);
+        std::vector<std::vector<Instr>> before(site + 1);
+        if (!is_list)
+            for (int f = 0; f < fields; ++f) before[site].push_back({OP_CONST, ceiling + f, nil_const, 0, alloc.line});
+        removed[site] = 1;
+
+        int pushed = 0;
+        for (int b = 0; b < (int)cfg.start.size(); ++b) {
+            std::vector<char> may = h.may_in[b], must = h.must_in[b];
+            std::vector<int> st = rc.in[b];
+            for (int pc = cfg.start[b]; pc < cfg.end(b); ++pc) {
+                Instr ins = code[pc];
+                auto holds = [&](int r) { return r >= 0 && r < nregs && must[r]; };
+                switch (ins.op) {
+                    case OP_MOVE:
+                        if (holds(ins.b)) removed[pc] = 1;
+                        break;
+                    case OP_STRUCT_SET:
+                        if (holds(ins.a)) code[pc] = {OP_MOVE, ceiling + ins.b, ins.c, 0, ins.line};
+                        break;
+                    case OP_STRUCT_GET: case OP_FIELD_GET_ITEM:
+                        if (holds(ins.b)) code[pc] = {OP_MOVE, ins.a, ceiling + ins.c, 0, ins.line};
+                        break;
+                    case OP_LIST_PUSH:
+                        if (holds(ins.a)) code[pc] = {OP_MOVE, ceiling + pushed++, ins.b, 0, ins.line};
+                        break;
+                    case OP_LIST_GET: case OP_LIST_GET_L:
+                        if (holds(ins.b)) code[pc] = {OP_MOVE, ins.a, ceiling + (int)const_index(constants, st, ins.c), 0, ins.line};
+                        break;
+                    case OP_LIST_SET:
+                        if (holds(ins.a)) code[pc] = {OP_MOVE, ceiling + (int)const_index(constants, st, ins.b), ins.c, 0, ins.line};
+                        break;
+                    case OP_LIST_LEN:
+                        if (holds(ins.b)) code[pc] = {OP_CONST, ins.a, add_constant(Value::make_int(fields)), 0, ins.line};
+                        break;
+                    default:
+                        break;
+                }
+                SiteHolders::step(ins, pc, site, may, must);
+                step_consts(ins, st);
+            }
+        }
+
+        remarks.push_back({"escape", alloc.line, std::string(is_list ? "list" : "item") + " kept in " +
+                           std::to_string(fields) + " registers instead of the heap"});
+        splice_code(removed, before);
+        changed = true;
+        site += (int)before[site].size() - 1;
+    }
+    return changed;
+}
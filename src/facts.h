@@ -11,6 +11,7 @@ inline const char* typekind_to_string(TypeKind op) {
         case TY_LIST:      return "list";
         case TY_TABLE:     return "table";
         case TY_ITEM:      return "item";
+        case TY_FILE:      return "file";
         default:           return "BAD";
     }
 }
@@ -42,6 +43,26 @@ inline const char* opcode_to_string(OpCode op) {
         case OP_LIST_GET:   return "OP_LIST_GET";
         case OP_LIST_SET:   return "OP_LIST_SET";
         case OP_LIST_LEN:   return "OP_LIST_LEN";
+        case OP_DIV_POW2:   return "OP_DIV_POW2";
+        case OP_ADD_NN:     return "OP_ADD_NN";
+        case OP_SUB_NN:     return "OP_SUB_NN";
+        case OP_MUL_NN:     return "OP_MUL_NN";
+        case OP_DIV_NN:     return "OP_DIV_NN";
+        case OP_LT_NN:      return "OP_LT_NN";
+        case OP_GT_NN:      return "OP_GT_NN";
+        case OP_LIST_GET_L: return "OP_LIST_GET_L";
+        case OP_FIELD_GET_ITEM: return "OP_FIELD_GET_ITEM";
+        case OP_MOVE_OWN:   return "OP_MOVE_OWN";
+        case OP_CALL_OWN:   return "OP_CALL_OWN";
+        case OP_MOVE_S:     return "OP_MOVE_S";
+        case OP_JMP_TRUE:   return "OP_JMP_TRUE";
+        case OP_CALL_MEMO:  return "OP_CALL_MEMO";
+        case OP_CONCAT:     return "OP_CONCAT";
+        case OP_CONCAT_N:   return "OP_CONCAT_N";
+        case OP_VEC_ADD:    return "OP_VEC_ADD";
+        case OP_VEC_SUB:    return "OP_VEC_SUB";
+        case OP_VEC_MUL:    return "OP_VEC_MUL";
+        case OP_VEC_DIV:    return "OP_VEC_DIV";
         default:            return "BAD";
     }
 }
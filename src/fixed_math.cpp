@@ -0,0 +1,149 @@
+#include "fixed_math.h"
+#include <cmath>
+
+namespace {
+    // intermediate results carry 62 fraction bits
+    constexpr int F = 62;
+    constexpr int64_t ONE = int64_t(1) << F;
+    // numbers the VM can hold: 61-bit intscaled values
+    constexpr wide_int Q_LIMIT = wide_int(1) << 60;
+
+    constexpr int64_t q62(long double x) { return (int64_t)(x * 4611686018427387904.0L + (x < 0 ? -0.5L : 0.5L)); }
+
+    constexpr int64_t LN2 = q62(0.693147180559945309417232121458176568L);
+    constexpr int64_t HALF_PI = q62(1.570796326794896619231321691639751442L);
+    constexpr int64_t SQRT2 = q62(1.414213562373095048801688724209698079L);
+
+    // 1/k! and 1/(2k+1), the series coefficients
+    struct Coefficients {
+        int64_t inv_fact[14];
+        int64_t inv_odd[8];
+        constexpr Coefficients() : inv_fact(), inv_odd() {
+            long double f = 1;
+            for (int k = 0; k < 14; ++k) {
+                if (k) f *= k;
+                inv_fact[k] = q62(1.0L / f);
+            }
+            for (int k = 0; k < 8; ++k) inv_odd[k] = q62(1.0L / (2 * k + 1));
+        }
+    };
+    constexpr Coefficients C;
+
+    inline int64_t mul62(int64_t a, int64_t b) { return (int64_t)(((wide_int)a * b) >> F); }
+
+    // 2.62 to 32.32, rounding to nearest
+    inline wide_int to_q32(wide_int v) { return (v + (wide_int(1) << (F - INTSCALED_SHIFT - 1))) >> (F - INTSCALED_SHIFT); }
+
+    inline bool fits(wide_int q, int64_t& out) {
+        if (q >= Q_LIMIT || q < -Q_LIMIT) return false;
+        out = (int64_t)q;
+        return true;
+    }
+
+    // round(a / b) for b > 0, halves away from negative infinity
+    inline wide_int div_round(wide_int a, int64_t b) {
+        wide_int n = a + b / 2;
+        wide_int k = n / b;
+        if (n % b < 0) --k;
+        return k;
+    }
+
+    // sin and cos on |r| <= pi/4 by their Taylor series to the 13th / 12th power
+    int64_t sin_series(int64_t r) {
+        int64_t z = mul62(r, r), p = C.inv_fact[13];
+        for (int k = 11; k >= 1; k -= 2) p = C.inv_fact[k] - mul62(z, p);
+        return mul62(r, p);
+    }
+    int64_t cos_series(int64_t r) {
+        int64_t z = mul62(r, r), p = C.inv_fact[12];
+        for (int k = 10; k >= 0; k -= 2) p = C.inv_fact[k] - mul62(z, p);
+        return p;
+    }
+
+    // x = n * pi/2 + r; sin x is then sin r, cos r, -sin r or -cos r by n mod 4
+    int64_t sin_quadrant(int64_t q, int shift) {
+        wide_int t = (wide_int)q << (F - INTSCALED_SHIFT);
+        wide_int n = div_round(t, HALF_PI);
+        int64_t r = (int64_t)(t - n * HALF_PI);
+        switch ((int)(n + shift) & 3) {
+            case 0: return sin_series(r);
+            case 1: return cos_series(r);
+            case 2: return -sin_series(r);
+            default: return -cos_series(r);
+        }
+    }
+
+    // ln of a positive 32.32 number in 2.62: x = m * 2^e with m in [sqrt(1/2), sqrt(2)), and
+    // ln m = 2 atanh s, s = (m - 1) / (m + 1), |s| < 0.172, summed to s^15
+    wide_int log62(int64_t q) {
+        int hb = 63 - __builtin_clzll((uint64_t)q);
+        int64_t m = hb >= F ? q >> (hb - F) : q << (F - hb);
+        int e = hb - INTSCALED_SHIFT;
+        if (m > SQRT2) { m >>= 1; ++e; }
+        int64_t s = (int64_t)(((wide_int)(m - ONE) << F) / ((wide_int)m + ONE));
+        int64_t z = mul62(s, s), p = C.inv_odd[7];
+        for (int k = 6; k >= 0; --k) p = C.inv_odd[k] + mul62(z, p);
+        return (wide_int)e * LN2 + 2 * (wide_int)mul62(s, p);
+    }
+
+    // e^t for t in 2.62: t = k ln 2 + r, |r| <= ln 2 / 2, e^r by its Taylor series to r^13
+    bool exp62(wide_int t, int64_t& out) {
+        if (t > (wide_int)LN2 * 40) return false;
+        if (t < -(wide_int)LN2 * 70) { out = 0; return true; }
+        int k = (int)div_round(t, LN2);
+        int64_t r = (int64_t)(t - (wide_int)k * LN2);
+        int64_t p = C.inv_fact[13];
+        for (int n = 12; n >= 0; --n) p = C.inv_fact[n] + mul62(r, p);
+        // p * 2^k in 32.32
+        int shift = F - INTSCALED_SHIFT - k;
+        wide_int q = shift > 0 ? ((wide_int)p + (wide_int(1) << (shift - 1))) >> shift : (wide_int)p << -shift;
+        return fits(q, out);
+    }
+}
+
+// the integer square root of q * 2^32, seeded from double and corrected to the nearest
+bool fixed_sqrt(int64_t q, int64_t& out) {
+    if (q < 0) return false;
+    unsigned __int128 u = (unsigned __int128)q << INTSCALED_SHIFT;
+    uint64_t r = (uint64_t)std::sqrt((double)u);
+    while ((unsigned __int128)r * r > u) --r;
+    while ((unsigned __int128)(r + 1) * (r + 1) <= u) ++r;
+    if (u - (unsigned __int128)r * r > r) ++r;
+    out = (int64_t)r;
+    return true;
+}
+
+bool fixed_exp(int64_t q, int64_t& out) {
+    return exp62((wide_int)q << (F - INTSCALED_SHIFT), out);
+}
+
+bool fixed_log(int64_t q, int64_t& out) {
+    if (q <= 0) return false;
+    return fits(to_q32(log62(q)), out);
+}
+
+// whole exponents multiply exactly, and allow negative x; others go through e^(y ln x)
+bool fixed_pow(int64_t x, int64_t y, int64_t& out) {
+    if ((y & (int64_t)(INTSCALED_ONE - 1)) == 0 && fixed_abs(y >> INTSCALED_SHIFT) <= 64) {
+        int64_t n = fixed_abs(y >> INTSCALED_SHIFT), result = INTSCALED_ONE, base = x;
+        for (; n; n >>= 1, base = intscaled_mul(base, base))
+            if (n & 1) result = intscaled_mul(result, base);
+        if (y >= 0) { out = result; return true; }
+        if (result == 0) return false;
+        out = intscaled_div(INTSCALED_ONE, result);
+        return true;
+    }
+    if (x == 0) { out = 0; return y > 0; }
+    if (x < 0) return false;
+    return exp62((log62(x) * y) >> INTSCALED_SHIFT, out);
+}
+
+bool fixed_sin(int64_t q, int64_t& out) {
+    out = (int64_t)to_q32(sin_quadrant(q, 0));
+    return true;
+}
+
+bool fixed_cos(int64_t q, int64_t& out) {
+    out = (int64_t)to_q32(sin_quadrant(q, 1));
+    return true;
+}
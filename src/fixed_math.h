@@ -0,0 +1,17 @@
+#pragma once
+#include "value.h"
+#include <cstdint>
+
+// math on 32.32 fixed point as numbers are stored (x * 2^32), without converting to double:
+// range reduction and series in 2.62 fixed point with 128-bit products, rounded once at the
+// end. Each returns false when x is outside the function's domain or the result does not fit.
+
+inline int64_t fixed_abs(int64_t q) { return q < 0 ? -q : q; }
+inline int64_t fixed_floor(int64_t q) { return q & ~(int64_t)(INTSCALED_ONE - 1); }
+
+bool fixed_sqrt(int64_t q, int64_t& out);
+bool fixed_exp(int64_t q, int64_t& out);
+bool fixed_log(int64_t q, int64_t& out);
+bool fixed_pow(int64_t x, int64_t y, int64_t& out);
+bool fixed_sin(int64_t q, int64_t& out);
+bool fixed_cos(int64_t q, int64_t& out);
@@ -0,0 +1,141 @@
+#include "assembler.h"
+#include <map>
+#include <algorithm>
+
+namespace {
+    struct CalleeBody {
+        int func = -1;
+        int start = 0, end = 0;
+        std::vector<int> offset;   // (pc - start) -> position inside the spliced sequence, -1 if unreachable
+        int kept = 0;              // reachable instructions
+        int size = 0;              // instructions emitted per splice (returns expand to move + jump)
+        int max_reg = -1;
+        bool recursive = false;
+        bool well_formed = true;
+    };
+
+    CalleeBody scan_body(const std::vector<Instr>& code, int func, int start, int end) {
+        CalleeBody b;
+        b.func = func; b.start = start; b.end = end;
+
+        // only what is reachable from the entry gets copied, so the trailing
+        // "return nil" after an explicit return does not bloat every call site
+        std::vector<char> seen(end - start, 0);
+        std::vector<int> work{start};
+        while (!work.empty()) {
+            int pc = work.back(); work.pop_back();
+            if (pc < start || pc >= end) { b.well_formed = false; continue; }
+            if (seen[pc - start]) continue;
+            seen[pc - start] = 1;
+            const Instr& ins = code[pc];
+            if (ins.op == OP_RETURN) continue;
+            if (ins.op == OP_JMP) { work.push_back(ins.b); continue; }
+            if (op_is_cond_jump(ins.op)) work.push_back(ins.b);
+            work.push_back(pc + 1);
+        }
+
+        b.offset.assign(end - start, -1);
+        for (int pc = start; pc < end; ++pc) {
+            if (!seen[pc - start]) continue;
+            const Instr& ins = code[pc];
+            b.offset[pc - start] = b.size;
+            b.size += (ins.op == OP_RETURN) ? 2 : 1;
+            b.kept++;
+
+            unsigned regs = reg_operands(ins.op);
+            if (regs & OPND_A) b.max_reg = std::max(b.max_reg, ins.a + call_arg_count(ins));
+            if (regs & OPND_B) b.max_reg = std::max(b.max_reg, ins.b);
+            if (regs & OPND_C) b.max_reg = std::max(b.max_reg, ins.c);
+            if (op_calls_pc(ins.op) && ins.b == start) b.recursive = true;
+        }
+        return b;
+    }
+}
+
+void Assembler::inline_small_functions(int budget, const std::vector<int>& callee_budget) {
+    if (functions.empty() || (budget <= 0 && callee_budget.empty())) return;
+
+    std::map<int, CalleeBody> bodies; // keyed by entry pc
+    for (size_t f = 0; f < functions.size(); ++f) {
+        int start = labels[functions[f].entry_label].target_pc;
+        int end = labels[functions[f].end_label].target_pc;
+        if (start < 0 || end <= start || end > (int)code.size()) continue;
+        bodies[start] = scan_body(code, (int)f, start, end);
+    }
+
+    // decide every call site against the original code first, then splice in one rebuild
+    int n = (int)code.size();
+    std::vector<const CalleeBody*> splice(n, nullptr);
+    std::vector<int> new_pos(n + 1, 0);
+    int pos = 0;
+    for (int i = 0; i < n; ++i) {
+        new_pos[i] = pos;
+        const Instr& ins = code[i];
+        if (ins.op == OP_CALL) {
+            auto it = bodies.find(ins.b);
+            if (it != bodies.end()) {
+                const CalleeBody& b = it->second;
+                const std::string& callee = functions[b.func].name;
+                // the parser allocates registers stack-wise, so everything above the
+                // argument window is dead at the call and can host the callee frame
+                int limit = callee_budget.empty() ? budget : callee_budget[b.func];
+                std::string why;
+                if (b.recursive) why = "recursive";
+                else if (!b.well_formed) why = "body leaves its own range";
+                else if (b.kept > limit) why = "size " + std::to_string(b.kept) + " exceeds budget " + std::to_string(limit);
+                else if (ins.a + 1 + b.max_reg >= MAX_FRAME_REGS) why = "caller frame too large";
+
+                if (why.empty()) {
+                    splice[i] = &b;
+                    remarks.push_back({"inline", ins.line, "inlined '" + callee + "' (" + std::to_string(b.kept) + " instrs)"});
+                    pos += b.size;
+                    continue;
+                }
+                remarks.push_back({"inline", ins.line, "not inlined '" + callee + "': " + why});
+            }
+        }
+        pos++;
+    }
+    new_pos[n] = pos;
+
+    bool any = false;
+    for (auto* s : splice) if (s) { any = true; break; }
+    if (!any) return;
+
+    std::vector<Instr> out;
+    out.reserve(pos);
+    for (int i = 0; i < n; ++i) {
+        if (!splice[i]) {
+            Instr ins = code[i];
+            if (op_has_pc_target(ins.op) && ins.b >= 0 && ins.b <= n) ins.b = new_pos[ins.b];
+            out.push_back(ins);
+            continue;
+        }
+
+        const CalleeBody& b = *splice[i];
+        const Instr call = code[i];
+        int off = call.a + 1;          // callee register r lives in caller register r + off
+        int base = new_pos[i];
+        int after = new_pos[i + 1];
+        for (int pc = b.start; pc < b.end; ++pc) {
+            if (b.offset[pc - b.start] < 0) continue;
+            Instr ins = code[pc];
+            unsigned regs = reg_operands(ins.op);
+            if (regs & OPND_A) ins.a += off;
+            if (regs & OPND_B) ins.b += off;
+            if (regs & OPND_C) ins.c += off;
+
+            if (ins.op == OP_RETURN) {
+                out.push_back({OP_MOVE, call.a, ins.a, 0, ins.line});
+                out.push_back({OP_JMP, 0, after, 0, ins.line});
+                continue;
+            }
+            if (ins.op == OP_JMP || op_is_cond_jump(ins.op)) ins.b = base + b.offset[ins.b - b.start];
+            else if (op_calls_pc(ins.op) && ins.b >= 0 && ins.b <= n) ins.b = new_pos[ins.b];
+            out.push_back(ins);
+        }
+    }
+
+    code.swap(out);
+    rebind_labels(new_pos, (int)code.size());
+}
@@ -1,5 +1,50 @@
 #include "lexer.h"
 #include <cctype>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+    struct Keyword { std::string_view text; TK kind; };
+
+    constexpr Keyword KEYWORDS[] = {
+        {"unit", TK::UNIT}, {"on", TK::ON}, {"if", TK::IF}, {"else", TK::ELSE}, {"while", TK::WHILE},
+        {"end", TK::KEY_END}, {"var", TK::VAR}, {"true", TK::BOOL}, {"false", TK::BOOL}, {"nil", TK::NIL},
+        {"as", TK::AS}, {"return", TK::RETURN}, {"item", TK::ITEM}, {"memo", TK::MEMO},
+    };
+
+    // length, first and last byte pick a distinct slot for every keyword
+    constexpr unsigned KEYWORD_SLOTS = 32;
+    constexpr unsigned keyword_hash(std::string_view s) {
+        return (unsigned)(s.size() * 9 + (unsigned char)s.front() + (unsigned char)s.back()) & (KEYWORD_SLOTS - 1);
+    }
+
+    struct KeywordTable { Keyword slot[KEYWORD_SLOTS]; };
+
+    constexpr KeywordTable make_keyword_table() {
+        KeywordTable t{};
+        for (auto& s : t.slot) s = {"", TK::IDENT};
+        for (const Keyword& k : KEYWORDS) t.slot[keyword_hash(k.text)] = k;
+        return t;
+    }
+
+    constexpr bool keyword_hash_is_perfect() {
+        KeywordTable t = make_keyword_table();
+        for (const Keyword& k : KEYWORDS)
+            if (t.slot[keyword_hash(k.text)].text != k.text) return false;
+        return true;
+    }
+    static_assert(keyword_hash_is_perfect(), "keyword_hash collides, pick other multipliers");
+
+    constexpr KeywordTable KEYWORD_TABLE = make_keyword_table();
+
+    TK classify_word(std::string_view s) {
+        const Keyword& k = KEYWORD_TABLE.slot[keyword_hash(s)];
+        return k.text == s ? k.kind : TK::IDENT;
+    }
+
+    bool is_word_char(char c) { return std::isalnum((unsigned char)c) || c == '_'; }
+}
 
 char Lexer::advance() {
     char c = peek();
@@ -13,52 +58,80 @@ bool Lexer::match(char c) {
     return false;
 }
 
-Token Lexer::next() {
+// 16 bytes at a time while whole blocks are whitespace, keeping line and col in step
+void Lexer::skip_whitespace() {
+#if defined(__SSE2__)
+    while (i + 16 <= src.size()) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src.data() + i));
+        __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+        __m128i ctl = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+        unsigned ws = (unsigned)_mm_movemask_epi8(_mm_or_si128(space, ctl));
+        unsigned nl = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        unsigned run = ws == 0xFFFF ? 16 : (unsigned)__builtin_ctz(~ws);
+        unsigned nl_in_run = nl & ((1u << run) - 1);
+        if (nl_in_run) {
+            line += __builtin_popcount(nl_in_run);
+            col = (int)run - (31 - __builtin_clz(nl_in_run));
+        } else
+            col += (int)run;
+        i += run;
+        if (run < 16) return;
+    }
+#endif
     while (std::isspace((unsigned char)peek())) advance();
+}
+
+// identifiers never span lines, so only the column moves
+size_t Lexer::identifier_end(size_t from) const {
+    size_t p = from;
+#if defined(__SSE2__)
+    while (p + 16 <= src.size()) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src.data() + p));
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+        __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+        unsigned word = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), under));
+        if (word != 0xFFFF) return p + (unsigned)__builtin_ctz(~word);
+        p += 16;
+    }
+#endif
+    while (p < src.size() && is_word_char(src[p])) p++;
+    return p;
+}
+
+Token Lexer::next() {
+    skip_whitespace();
     int start_col = col;
     int start_line = line;
+    size_t start = i;
     char c = peek();
     if (c == '\0') return {TK::END_FILE, "", start_line, start_col};
     if (std::isalpha((unsigned char)c) || c == '_') {
-        std::string s;
-        while (std::isalnum((unsigned char)peek()) || peek() == '_') s += advance();
-        if (s == "unit") return {TK::UNIT, s, start_line, start_col};
-        if (s == "on") return {TK::ON, s, start_line, start_col};
-        if (s == "if") return {TK::IF, s, start_line, start_col};
-        if (s == "else") return {TK::ELSE, s, start_line, start_col};
-        if (s == "while") return {TK::WHILE, s, start_line, start_col};
-        if (s == "end") return {TK::KEY_END, s, start_line, start_col};
-        if (s == "var") return {TK::VAR, s, start_line, start_col};
-        if (s == "true" || s == "false") return {TK::BOOL, s, start_line, start_col};
-        if (s == "nil") return {TK::NIL, s, start_line, start_col};
-        if (s == "as") return {TK::AS, s, start_line, start_col};
-        if (s == "return") return {TK::RETURN, s, start_line, start_col};
-        if (s == "item") return {TK::ITEM, s, start_line, start_col};
-        return {TK::IDENT, s, start_line, start_col};
+        size_t end = identifier_end(i);
+        col += (int)(end - i);
+        i = end;
+        std::string_view s = src.substr(start, end - start);
+        return {classify_word(s), s, start_line, start_col};
     }
     if (std::isdigit((unsigned char)c)) {
-        std::string s;
-        while (std::isdigit((unsigned char)peek())) s += advance();
+        while (std::isdigit((unsigned char)peek())) advance();
         if (peek() == '.' && std::isdigit((unsigned char)peek(1))) {
-            s += advance();
-            while (std::isdigit((unsigned char)peek())) s += advance();
+            advance();
+            while (std::isdigit((unsigned char)peek())) advance();
         }
-        return {TK::NUMBER, s, start_line, start_col};
+        return {TK::NUMBER, src.substr(start, i - start), start_line, start_col};
     }
     if (c == '"') {
         advance();
-        std::string s;
+        size_t body = i;
         while (peek() != '"' && peek() != '\0') {
             char ch = advance();
-            if (ch == '\\' && peek() != '\0') {
-                char nx = advance();
-                if (nx == 'n') s.push_back('\n');
-                else if (nx == 't') s.push_back('\t');
-                else s.push_back(nx);
-            } else s.push_back(ch);
+            if (ch == '\\' && peek() != '\0') advance();
         }
+        std::string_view raw = src.substr(body, i - body);
         if (peek() == '"') advance();
-        return {TK::STRING, s, start_line, start_col};
+        return {TK::STRING, raw, start_line, start_col};
     }
     advance();
     switch (c) {
@@ -78,9 +151,22 @@ Token Lexer::next() {
         case ',': return {TK::COMMA, ",", start_line, start_col};
         case '.': return {TK::DOT, ".", start_line, start_col};
         case ':': return {TK::COLON, ":", start_line, start_col};
-        default: {
-            std::string s(1, c);
-            return {TK::TK_BAD, s, start_line, start_col};
-        }
+        default:
+            return {TK::TK_BAD, src.substr(start, 1), start_line, start_col};
+    }
+}
+
+std::string unescape_string(std::string_view raw) {
+    std::string s;
+    s.reserve(raw.size());
+    for (size_t k = 0; k < raw.size(); ++k) {
+        char ch = raw[k];
+        if (ch == '\\' && k + 1 < raw.size()) {
+            char nx = raw[++k];
+            if (nx == 'n') s.push_back('\n');
+            else if (nx == 't') s.push_back('\t');
+            else s.push_back(nx);
+        } else s.push_back(ch);
     }
+    return s;
 }
@@ -1,22 +1,31 @@
 #pragma once
 #include <string>
+#include <string_view>
 
 enum class TK {
     TK_BAD, END_FILE, IDENT, NUMBER, STRING, BOOL, NIL, UNIT, ON, IF, ELSE, WHILE,
     KEY_END, VAR, PLUS, MINUS, MUL, DIV, ASSIGN, EQ, LT, GT, LP, RP,
-    LBRACE, RBRACE, COMMA, DOT, COLON, AS, LBRACK, RBRACK, RETURN, ITEM
+    LBRACE, RBRACE, COMMA, DOT, COLON, AS, LBRACK, RBRACK, RETURN, ITEM, MEMO
 };
 
-struct Token { TK k; std::string lex; int line; int col; };
+// lex points into the source buffer, which must outlive the token; STRING tokens span the
+// raw text between the quotes (see unescape_string)
+struct Token { TK k; std::string_view lex; int line; int col; };
 
 struct Lexer {
-    std::string src;
+    std::string_view src;
     size_t i = 0;
     int line = 1;
     int col = 1;
-    Lexer(const std::string& s): src(s) {}
+    Lexer(std::string_view s): src(s) {}
     char peek(int offset = 0) const { return (i + offset < src.size()) ? src[i + offset] : '\0'; }
     char advance();
     bool match(char c);
     Token next();
+
+private:
+    void skip_whitespace();
+    size_t identifier_end(size_t from) const;
 };
+
+std::string unescape_string(std::string_view raw);
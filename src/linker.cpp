@@ -0,0 +1,266 @@
+#include "linker.h"
+#include "bytecode_io.h"
+#include "compile_cache.h"
+#include "lexer.h"
+#include <atomic>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+    std::vector<Token> tokenize(std::string_view source) {
+        std::vector<Token> tokens;
+        Lexer lx(source);
+        while (true) {
+            tokens.push_back(lx.next());
+            if (tokens.back().k == TK::END_FILE) break;
+        }
+        return tokens;
+    }
+
+    // everything an importer's code depends on, part of its cache key
+    std::string import_context(const UnitSource& u, const std::map<std::string, const UnitSource*>& by_name, bool library) {
+        std::string ctx = library ? "module library" : "module entry";
+        for (const auto& [dep, alias] : u.iface.deps) {
+            ctx += "|" + dep + " as " + alias + ":";
+            for (const ExportSig& e : by_name.at(dep)->iface.exports) {
+                ctx += e.name;
+                for (TypeKind t : e.param_types) { ctx += ','; ctx += std::to_string((int)t); }
+                ctx += "->";
+                ctx += std::to_string((int)e.return_type);
+                ctx += ';';
+            }
+        }
+        return ctx;
+    }
+
+    template<typename T> void put(std::ostream& out, T v) { out.write(reinterpret_cast<const char*>(&v), sizeof v); }
+    template<typename T> T get(std::istream& in) {
+        T v{};
+        in.read(reinterpret_cast<char*>(&v), sizeof v);
+        if (!in) throw std::runtime_error("Truncated module image");
+        return v;
+    }
+
+    std::string write_module(Module& m) {
+        std::ostringstream out(std::ios::binary);
+        BytecodeIO::write(out, m.as);
+        put<uint32_t>(out, (uint32_t)m.exports.size());
+        for (const ExportBody& e : m.exports) {
+            put<uint32_t>(out, (uint32_t)e.name.size());
+            out.write(e.name.data(), (std::streamsize)e.name.size());
+            put<int32_t>(out, e.entry_pc);
+            put<int32_t>(out, e.end_pc);
+        }
+        put<uint32_t>(out, (uint32_t)m.import_calls.size());
+        for (const ImportCall& ic : m.import_calls) {
+            put<uint32_t>(out, (uint32_t)ic.unit.size());
+            out.write(ic.unit.data(), (std::streamsize)ic.unit.size());
+            put<int32_t>(out, ic.export_index);
+        }
+        return out.str();
+    }
+
+    Module read_module(const std::string& unit, const std::string& image) {
+        std::istringstream in(image, std::ios::binary);
+        Module m;
+        m.unit = unit;
+        BytecodeIO::read(in, m.as);
+        m.exports.resize(get<uint32_t>(in));
+        for (ExportBody& e : m.exports) {
+            e.name.resize(get<uint32_t>(in));
+            in.read(e.name.data(), (std::streamsize)e.name.size());
+            e.entry_pc = get<int32_t>(in);
+            e.end_pc = get<int32_t>(in);
+        }
+        m.import_calls.resize(get<uint32_t>(in));
+        for (ImportCall& ic : m.import_calls) {
+            ic.unit.resize(get<uint32_t>(in));
+            in.read(ic.unit.data(), (std::streamsize)ic.unit.size());
+            ic.export_index = get<int32_t>(in);
+        }
+        return m;
+    }
+
+    // how a unit's functions are named in the linked program, and so in its profiles
+    std::string function_scope(const std::string& unit, bool multi_unit) { return multi_unit ? unit + "." : ""; }
+
+    Module compile_module(const UnitSource& u, const std::map<std::string, const UnitSource*>& by_name,
+                          const CompilerOptions& opts, bool library, const Profile* profile) {
+        SourceManager sm(u.text(), u.path);
+        Compiler comp(u.text(), opts);
+        comp.is_library = library;
+        comp.profile = profile;
+        comp.profile_scope = function_scope(u.iface.name, by_name.size() > 1);
+        for (const auto& [dep, alias] : u.iface.deps) comp.imports[alias] = {dep, by_name.at(dep)->iface.exports};
+        comp.compile_unit(&sm);
+
+        Module m;
+        m.unit = u.iface.name;
+        if (comp.asm_.functions.size() != u.iface.exports.size())
+            throw std::runtime_error("Unit '" + m.unit + "' does not match its scanned interface");
+        for (const FuncInfo& f : comp.asm_.functions)
+            m.exports.push_back({f.name, comp.asm_.labels[f.entry_label].target_pc, comp.asm_.labels[f.end_label].target_pc});
+        m.import_calls = comp.import_calls;
+        m.as = std::move(comp.asm_);
+        return m;
+    }
+}
+
+UnitInterface scan_unit_interface(std::string_view source) {
+    std::vector<Token> t = tokenize(source);
+    UnitInterface iface;
+    size_t i = 0;
+    if (t[i].k == TK::UNIT && t[i + 1].k == TK::IDENT) {
+        iface.name = std::string(t[i + 1].lex);
+        i += 2;
+        if (t[i].k == TK::COLON) {
+            ++i;
+            while (t[i].k == TK::IDENT) {
+                std::string dep(t[i].lex), alias = dep;
+                ++i;
+                if (t[i].k == TK::AS && t[i + 1].k == TK::IDENT) { alias = std::string(t[i + 1].lex); i += 2; }
+                iface.deps.push_back({dep, alias});
+                if (t[i].k != TK::COMMA) break;
+                ++i;
+            }
+        }
+    }
+
+    std::set<std::string> items;
+    for (size_t k = 0; k + 1 < t.size(); ++k)
+        if (t[k].k == TK::ITEM && t[k + 1].k == TK::IDENT) items.emplace(t[k + 1].lex);
+    auto type_of = [&](std::string_view s) {
+        TypeKind tk = parse_type_name(s);
+        if (tk == TY_UNKNOWN && items.count(std::string(s))) tk = TY_ITEM;
+        return tk;
+    };
+
+    // one export per 'on', in the order Parser::compile_unit records FuncInfo
+    for (size_t k = 0; k + 2 < t.size(); ++k) {
+        if (t[k].k != TK::ON) continue;
+        ExportSig e;
+        e.return_type = type_of(t[k + 1].lex);
+        e.name = std::string(t[k + 2].lex);
+        size_t p = k + 3;
+        if (p < t.size() && t[p].k == TK::LP) {
+            ++p;
+            while (p + 2 < t.size() && t[p].k == TK::IDENT && t[p + 1].k == TK::COLON) {
+                e.param_types.push_back(type_of(t[p + 2].lex));
+                p += 3;
+                if (t[p].k != TK::COMMA) break;
+                ++p;
+            }
+        }
+        iface.exports.push_back(std::move(e));
+    }
+    return iface;
+}
+
+std::vector<UnitSource> load_program_units(const std::string& main_path) {
+    std::vector<UnitSource> units;
+    std::set<std::string> seen;
+    std::vector<std::string> pending = {main_path};
+    std::vector<std::string> expected_names = {""};   // unit each file must declare
+    for (size_t n = 0; n < pending.size(); ++n) {
+        UnitSource u;
+        u.path = pending[n];
+        u.source = SourceBuffer::map_file(u.path);
+        u.iface = scan_unit_interface(u.text());
+        if (!expected_names[n].empty() && u.iface.name != expected_names[n])
+            throw std::runtime_error(u.path + " declares unit '" + u.iface.name + "', expected '" + expected_names[n] + "'");
+        seen.insert(u.iface.name);
+
+        std::filesystem::path dir = std::filesystem::path(u.path).parent_path();
+        for (const auto& dep : u.iface.deps) {
+            if (seen.count(dep.first)) continue;
+            seen.insert(dep.first);
+            pending.push_back((dir / (dep.first + ".mon")).string());
+            expected_names.push_back(dep.first);
+        }
+        units.push_back(std::move(u));
+    }
+    return units;
+}
+
+std::vector<Module> compile_modules(const std::vector<UnitSource>& units, const CompilerOptions& opts, CompileCache* cache,
+                                    const Profile* profile) {
+    std::map<std::string, const UnitSource*> by_name;
+    for (const UnitSource& u : units) by_name[u.iface.name] = &u;
+
+    std::vector<Module> modules(units.size());
+    std::vector<std::exception_ptr> errors(units.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t n; (n = next++) < units.size();) {
+            try {
+                const UnitSource& u = units[n];
+                bool library = n > 0;
+                std::string context = import_context(u, by_name, library);
+                std::string image;
+                if (cache && cache->load(u.text(), opts, context, image)) {
+                    modules[n] = read_module(u.iface.name, image);
+                    continue;
+                }
+                modules[n] = compile_module(u, by_name, opts, library, profile);
+                if (cache) cache->store(u.text(), opts, context, write_module(modules[n]));
+            } catch (...) {
+                errors[n] = std::current_exception();
+            }
+        }
+    };
+
+    size_t workers = std::min<size_t>(units.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> pool;
+    for (size_t w = 1; w < workers; ++w) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+
+    for (auto& e : errors) if (e) std::rethrow_exception(e);
+    return modules;
+}
+
+void link_modules(std::vector<Module>& modules, Assembler& out) {
+    std::map<std::string, size_t> index;
+    std::vector<int> base(modules.size());
+    int size = 0;
+    for (size_t m = 0; m < modules.size(); ++m) {
+        index[modules[m].unit] = m;
+        base[m] = size;
+        size += (int)modules[m].as.code.size();
+    }
+
+    out.code.reserve(size);
+    for (size_t m = 0; m < modules.size(); ++m) {
+        Module& mod = modules[m];
+        std::vector<int> const_map(mod.as.constants.size());
+        for (size_t k = 0; k < mod.as.constants.size(); ++k) const_map[k] = out.add_constant(mod.as.constants[k]);
+
+        for (Instr ins : mod.as.code) {
+            if (ins.op == OP_CONST) ins.b = const_map[ins.b];
+            else if (op_has_pc_target(ins.op) && ins.b >= 0) ins.b += base[m];
+            else if (op_calls_pc(ins.op)) {
+                int slot = import_call_slot(ins.b);
+                if (slot < 0 || slot >= (int)mod.import_calls.size())
+                    throw std::runtime_error("Unresolved call in unit '" + mod.unit + "'");
+                const ImportCall& ic = mod.import_calls[slot];
+                auto it = index.find(ic.unit);
+                if (it == index.end() || ic.export_index < 0 || ic.export_index >= (int)modules[it->second].exports.size())
+                    throw std::runtime_error("Unit '" + mod.unit + "' calls into missing unit '" + ic.unit + "'");
+                ins.b = base[it->second] + modules[it->second].exports[ic.export_index].entry_pc;
+            }
+            out.code.push_back(ins);
+        }
+        for (const ExportBody& e : mod.exports) {
+            FuncInfo f{function_scope(mod.unit, modules.size() > 1) + e.name, out.make_label(), out.make_label()};
+            out.labels[f.entry_label].target_pc = base[m] + e.entry_pc;
+            out.labels[f.end_label].target_pc = base[m] + e.end_pc;
+            out.functions.push_back(f);
+        }
+        out.remarks.insert(out.remarks.end(), mod.as.remarks.begin(), mod.as.remarks.end());
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "assembler.h"
+#include "compiler.h"
+#include "source_manager.h"
+
+class CompileCache;
+struct Profile;
+
+// what importers need from a unit, read from its source without compiling it
+struct UnitInterface {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> deps;   // unit, alias
+    std::vector<ExportSig> exports;
+};
+
+struct UnitSource {
+    std::string path;
+    std::shared_ptr<const SourceBuffer> source;
+    UnitInterface iface;
+
+    std::string_view text() const { return source->text(); }
+};
+
+// body of an exported function, [entry_pc, end_pc) in its module's code
+struct ExportBody {
+    std::string name;
+    int entry_pc;
+    int end_pc;
+};
+
+// one compiled unit: code with its own pcs and constant indices, calls into other
+// units left as import_call_ref slots
+struct Module {
+    std::string unit;
+    Assembler as;
+    std::vector<ExportBody> exports;       // in UnitInterface order
+    std::vector<ImportCall> import_calls;
+};
+
+UnitInterface scan_unit_interface(std::string_view source);
+
+// the main unit first, then every unit it names transitively, read from <dir>/<unit>.mon
+std::vector<UnitSource> load_program_units(const std::string& main_path);
+
+// compiles units in parallel; unchanged units whose imports did not change come from the cache.
+// A profile steers inlining, so pass no cache with one.
+std::vector<Module> compile_modules(const std::vector<UnitSource>& units, const CompilerOptions& opts, CompileCache* cache,
+                                    const Profile* profile = nullptr);
+
+// concatenates the modules (the first one holds the entry point) and resolves calls between
+// them; every export becomes a function of `out`, so whole-program passes can see the bodies
+void link_modules(std::vector<Module>& modules, Assembler& out);
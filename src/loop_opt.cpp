@@ -0,0 +1,160 @@
+#include "assembler.h"
+#include "dataflow.h"
+
+namespace {
+    struct LoopFacts {
+        std::vector<int> defs;      // definitions of each register inside the loop
+        std::vector<int> def_pc;    // pc of the last one
+        bool writes_heap = false;   // stores or calls somewhere in the body
+    };
+
+    LoopFacts scan_loop(const std::vector<Instr>& code, const Loop& L, int nregs) {
+        LoopFacts f;
+        f.defs.assign(nregs, 0);
+        f.def_pc.assign(nregs, -1);
+        for (int pc = L.first_pc; pc <= L.last_pc; ++pc) {
+            const Instr& ins = code[pc];
+            int d = op_may_replace_a(ins.op) ? ins.a : instr_def(ins);
+            if (d >= 0 && d < nregs) { f.defs[d]++; f.def_pc[d] = pc; }
+            switch (ins.op) {
+                case OP_NOP: case OP_JMP: case OP_JMP_FALSE: case OP_JMP_TRUE: case OP_RETURN:
+                    break;
+                default:
+                    if (!op_is_pure(ins.op) && !op_allocates(ins.op)) f.writes_heap = true;
+                    break;
+            }
+        }
+        return f;
+    }
+
+    int64_t power_of_two_log(int64_t q) {
+        if (q <= 0 || (q & (q - 1)) != 0) return -1;
+        return __builtin_ctzll((unsigned long long)q);
+    }
+}
+
+// moves pure instructions whose operands do not change inside a loop into a preheader
+bool Assembler::pass_loop_invariant_motion() {
+    bool changed = false;
+    std::vector<int> uses;
+    // one loop per round, so nested loops see the code hoisted out of their inner loops
+    for (int round = 0; round < 64; ++round) {
+        ControlFlow cfg; cfg.build(*this);
+        Liveness live; live.compute(code, cfg);
+        bool hoisted = false;
+        for (const Loop& L : find_loops(cfg)) {
+            LoopFacts f = scan_loop(code, L, live.nregs);
+
+            RegSet exit_live; exit_live.resize(live.nregs);
+            for (int b = L.header; b <= cfg.block_of[L.last_pc]; ++b)
+                for (int s : cfg.succ[b])
+                    if (cfg.start[s] < L.first_pc || cfg.start[s] > L.last_pc) exit_live.merge(live.in[s]);
+
+            std::vector<char> hoisted_def(live.nregs, 0);
+            std::vector<char> removed(code.size(), 0);
+            std::vector<Instr> pre;
+            for (int pc = L.first_pc; pc <= L.last_pc; ++pc) {
+                const Instr& ins = code[pc];
+                if (!op_is_pure(ins.op) || (op_reads_heap(ins.op) && f.writes_heap)) continue;
+                int d = ins.a;
+                // the only definition, not read before it and not observed after the loop
+                if (f.defs[d] != 1 || live.in[L.header].test(d) || exit_live.test(d)) continue;
+                bool invariant = true;
+                instr_uses(ins, uses);
+                for (int r : uses) if (f.defs[r] != 0 && !hoisted_def[r]) { invariant = false; break; }
+                if (!invariant) continue;
+                hoisted_def[d] = 1;
+                removed[pc] = 1;
+                pre.push_back(ins);
+            }
+            if (pre.empty()) continue;
+
+            remarks.push_back({"licm", code[L.first_pc].line, "hoisted " + std::to_string(pre.size()) + " instrs out of loop"});
+            std::vector<std::vector<Instr>> before(L.first_pc + 1);
+            before[L.first_pc] = std::move(pre);
+            splice_code(removed, before, L.first_pc, L.last_pc);
+            hoisted = changed = true;
+            break;
+        }
+        if (!hoisted) break;
+    }
+    return changed;
+}
+
+// "t = i * k" with i stepped by a constant becomes a running sum updated next to i
+bool Assembler::pass_strength_reduce() {
+    ControlFlow cfg; cfg.build(*this);
+    Liveness live; live.compute(code, cfg);
+    ReachingConsts rc; rc.compute(code, cfg, live.nregs);
+
+    for (const Loop& L : find_loops(cfg)) {
+        LoopFacts f = scan_loop(code, L, live.nregs);
+        const std::vector<int>& on_entry = rc.in[L.header];
+        auto invariant_num = [&](int r, int64_t& q) {
+            if (r < 0 || r >= live.nregs || f.defs[r] != 0 || on_entry[r] < 0) return false;
+            const Value& v = constants[on_entry[r]];
+            if (!v.is_num()) return false;
+            q = v.as_intscaled();
+            return true;
+        };
+
+        for (int p = L.first_pc; p <= L.last_pc; ++p) {
+            const Instr mul = code[p];
+            if (generic_number_op(mul.op) != OP_MUL) continue;
+            int iv = -1, k_reg = -1;
+            int64_t k = 0;
+            if (invariant_num(mul.c, k)) { iv = mul.b; k_reg = mul.c; }
+            else if (invariant_num(mul.b, k)) { iv = mul.c; k_reg = mul.b; }
+            if (iv < 0 || iv == mul.a || f.defs[iv] != 1 || f.defs[mul.a] != 1) continue;
+
+            int d = f.def_pc[iv];
+            const Instr step = code[d];
+            int64_t s = 0;
+            OpCode step_op = generic_number_op(step.op);
+            bool basic = (step_op == OP_ADD && ((step.b == iv && invariant_num(step.c, s)) || (step.c == iv && invariant_num(step.b, s))))
+                      || (step_op == OP_SUB && step.b == iv && invariant_num(step.c, s));
+            if (!basic || d >= L.last_pc) continue;
+
+            // the running sum is only exact when every step adds a whole fixed-point value
+            wide_int sk = (wide_int)s * (wide_int)k;
+            if (sk % ((wide_int)1 << INTSCALED_SHIFT) != 0) continue;
+
+            int acc = function_register_ceiling(p);
+            if (acc < 0 || acc + 2 > MAX_FRAME_REGS) continue;
+            int inc = acc + 1;
+            int inc_const = add_constant(Value::make_intscaled((int64_t)(sk >> INTSCALED_SHIFT)));
+
+            std::vector<std::vector<Instr>> before(d + 2);
+            before[L.first_pc] = { {mul.op, acc, iv, k_reg, mul.line}, {OP_CONST, inc, inc_const, 0, mul.line} };
+            before[d + 1] = { {step.op, acc, acc, inc, step.line} };
+            code[p] = {OP_MOVE, mul.a, acc, 0, mul.line};
+            remarks.push_back({"strength", mul.line, "multiply by induction variable replaced with a running sum"});
+            splice_code(std::vector<char>(code.size(), 0), before, L.first_pc, L.last_pc);
+            return true;
+        }
+    }
+    return false;
+}
+
+// typed division by a constant power of two becomes a shift with OP_DIV's truncation
+bool Assembler::pass_reduce_division() {
+    ControlFlow cfg; cfg.build(*this);
+    ReachingConsts rc; rc.compute(code, cfg, max_register(code, 0, (int)code.size()) + 1);
+    bool changed = false;
+    for (int b = 0; b < (int)cfg.start.size(); ++b) {
+        std::vector<int> st = rc.in[b];
+        for (int pc = cfg.start[b]; pc < cfg.end(b); ++pc) {
+            Instr& ins = code[pc];
+            if (ins.op == OP_DIV_NN && ins.c < (int)st.size() && st[ins.c] >= 0 && constants[st[ins.c]].is_num()) {
+                int64_t shift = power_of_two_log(constants[st[ins.c]].as_intscaled());
+                if (shift >= 0) {
+                    ins = {OP_DIV_POW2, ins.a, ins.b, (int)shift - INTSCALED_SHIFT, ins.line};
+                    remarks.push_back({"strength", ins.line, "division by a power of two replaced with a shift"});
+                    changed = true;
+                }
+            }
+            step_consts(ins, st);
+        }
+    }
+    return changed;
+}
@@ -1,18 +1,72 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include "compiler.h"
 #include "bytecode_io.h"
 #include "vm.h"
 #include "source_manager.h"
 #include "builtin_std.h"
+#include "compile_cache.h"
+#include "linker.h"
+#include "compile_bench.h"
+#include "profile.h"
+#include <cstdlib>
+#include <sstream>
+#include <string>
 
 void print_help() {
     std::cout << "MonDot Compiler & VM\n";
     std::cout << "Usage:\n";
-    std::cout << "  mondot build <file.mon> -o <output.mdotc>\n";
-    std::cout << "  mondot run <file.mdotc>\n";
-    std::cout << "  mondot <file.mon> (compiles and runs on memory)\n";
+    std::cout << "  mondot build <file.mon> -o <output.mdotc> [--report] [--profile-in <file.prof>]\n";
+    std::cout << "    (units named in the header are read from <unit>.mon next to the file)\n";
+    std::cout << "  mondot run <file.mdotc> [--profile-out <file.prof>] [--stats]\n";
+    std::cout << "  mondot <file.mon> [--profile-out <file.prof>] [--stats] (compiles and runs on memory, reusing cached bytecode)\n";
+    std::cout << "  mondot cache stats|clear\n";
+    std::cout << "  mondot bench compile [lines] (front-end throughput on generated units, default 100000 lines)\n";
+}
+
+static size_t image_size(Assembler& as) {
+    std::ostringstream out(std::ios::binary);
+    BytecodeIO::write(out, as);
+    return out.str().size();
+}
+
+// functions nothing reachable from main calls are dropped from the linked program
+static void eliminate_dead_functions(Assembler& program, bool report) {
+    if (!report) { program.eliminate_dead_functions(); return; }
+    size_t funcs = program.functions.size(), before = image_size(program);
+    size_t remarks = program.remarks.size();
+    int dropped = program.eliminate_dead_functions();
+    for (size_t r = remarks; r < program.remarks.size(); ++r)
+        std::cout << "line " << program.remarks[r].line << ": [" << program.remarks[r].pass << "] " << program.remarks[r].msg << "\n";
+    std::cout << "[dead-functions] " << dropped << " of " << funcs << " functions removed, "
+              << (before - image_size(program)) << " bytes saved\n";
+}
+
+struct RunFlags {
+    std::string profile_out;   // counts of the run, keyed so a later build of the same sources can find them
+    bool stats = false;        // VM counters on stderr afterwards
+};
+
+// flags after the program of "run" and "<file.mon>"
+static bool parse_run_flags(int argc, char* argv[], int first, RunFlags& flags) {
+    for (int i = first; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag == "--profile-out" && i + 1 < argc) flags.profile_out = argv[++i];
+        else if (flag == "--stats") flags.stats = true;
+        else return false;
+    }
+    return true;
+}
+
+static void run_program(VM& vm, const Assembler& program, const RunFlags& flags) {
+    if (const char* m = std::getenv("MONDOT_MEMO_CAPACITY")) vm.memo_capacity = std::strtoull(m, nullptr, 10);
+    ProfileCounters counters;
+    if (!flags.profile_out.empty()) vm.profile = &counters;
+    vm.run();
+    if (!flags.profile_out.empty()) Profile::collect(program, counters).save(flags.profile_out);
+    if (flags.stats) {
+        MemoCache::Stats memo = vm.memo_stats();
+        std::cerr << "memo: " << memo.hits << " hits, " << memo.misses << " misses, " << memo.evictions << " evictions\n";
+    }
 }
 
 int main(int argc, char* argv[])
@@ -29,18 +83,53 @@ int main(int argc, char* argv[])
         if (argc < 5) { print_help(); return 1; }
         std::string input_file = argv[2];
         std::string output_file = argv[4];
-        std::ifstream f(input_file);
-        if (!f) { std::cerr << "Error when opening " << input_file << std::endl; return 1; }
-        std::stringstream buffer; buffer << f.rdbuf();
-        SourceManager sm(buffer.str(), input_file);
+        bool report = false;
+        std::string profile_in;
+        for (int i = 5; i < argc; ++i) {
+            std::string flag = argv[i];
+            if (flag == "--report") report = true;
+            else if (flag == "--profile-in" && i + 1 < argc) profile_in = argv[++i];
+            else { print_help(); return 1; }
+        }
+        Profile profile;
+        try {
+            if (!profile_in.empty()) profile = Profile::load(profile_in);
+        } catch (std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        std::vector<UnitSource> units;
+        try {
+            units = load_program_units(input_file);
+        } catch (std::exception& e) {
+            std::cerr << "Error when opening " << e.what() << std::endl;
+            return 1;
+        }
 
         auto opts = CompilerOptions();
         opts.max_opt_iters = 8;
         opts.opt_level = 2;
+        // a report needs the remarks of a real compile, and cached code was built without the profile
+        CompileCache cache = report || !profile_in.empty() ? CompileCache("", 0) : CompileCache::from_env();
         try {
-            Compiler comp(buffer.str(), opts);
-            comp.compile_unit(&sm);
-            BytecodeIO::save(output_file, comp.asm_, true);
+            std::vector<Module> modules = compile_modules(units, opts, &cache, profile_in.empty() ? nullptr : &profile);
+            if (report)
+                for (auto &m : modules)
+                    for (auto &r : m.as.remarks) {
+                        if (modules.size() > 1) std::cout << m.unit << " ";
+                        std::cout << "line " << r.line << ": [" << r.pass << "] " << r.msg << "\n";
+                    }
+            Assembler program;
+            link_modules(modules, program);
+            if (opts.opt_level >= 1) eliminate_dead_functions(program, report);
+            if (!profile_in.empty()) {
+                size_t remarks = program.remarks.size();
+                program.apply_profile(profile);
+                if (report)
+                    for (size_t r = remarks; r < program.remarks.size(); ++r)
+                        std::cout << "line " << program.remarks[r].line << ": [" << program.remarks[r].pass << "] " << program.remarks[r].msg << "\n";
+            }
+            BytecodeIO::save(output_file, program, true);
         } catch (std::exception& e) {
             return 1;
         }
@@ -48,25 +137,59 @@ int main(int argc, char* argv[])
     } else if (mode == "run") {
         if (argc < 3) { print_help(); return 1; }
         std::string input_file = argv[2];
+        RunFlags flags;
+        if (!parse_run_flags(argc, argv, 3, flags)) { print_help(); return 1; }
         try {
             Assembler as;
             BytecodeIO::load(input_file, as);
             VM vm(as);
-            vm.run();
+            run_program(vm, as, flags);
         } catch (std::exception& e) {
             return 1;
         } 
         return 0;
+    } else if (mode == "cache") {
+        if (argc < 3) { print_help(); return 1; }
+        std::string action = argv[2];
+        CompileCache cache = CompileCache::from_env();
+        if (!cache.enabled()) { std::cerr << "Compile cache is disabled" << std::endl; return 1; }
+        if (action == "stats") {
+            auto s = cache.stats();
+            uint64_t lookups = s.hits + s.misses;
+            std::cout << "dir:     " << cache.dir() << "\n";
+            std::cout << "entries: " << s.entries << " (" << s.bytes << " bytes)\n";
+            std::cout << "hits:    " << s.hits << "\n";
+            std::cout << "misses:  " << s.misses << "\n";
+            if (lookups) std::cout << "hit rate: " << (s.hits * 100 / lookups) << "%\n";
+        } else if (action == "clear") {
+            cache.clear();
+        } else { print_help(); return 1; }
+        return 0;
+    } else if (mode == "bench") {
+        if (argc < 3 || std::string(argv[2]) != "compile") { print_help(); return 1; }
+        int lines = argc > 3 ? std::atoi(argv[3]) : 100000;
+        if (lines < 8) { print_help(); return 1; }
+        return run_compile_bench(lines);
     } else {
-        std::ifstream f(mode);
-        if (!f) { std::cerr << "File not found: " << mode << std::endl; return 1; }
-        std::stringstream buffer; buffer << f.rdbuf();
-        SourceManager sm(buffer.str(), mode);
+        RunFlags flags;
+        if (!parse_run_flags(argc, argv, 2, flags)) { print_help(); return 1; }
+        std::vector<UnitSource> units;
+        try {
+            units = load_program_units(mode);
+        } catch (std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        SourceManager sm(units[0].text(), mode);
+        CompilerOptions opts;
+        CompileCache cache = CompileCache::from_env();
         try {
-            Compiler comp(buffer.str());
-            comp.compile_unit(&sm);
-            VM vm(comp.asm_, &sm);
-            vm.run();
+            std::vector<Module> modules = compile_modules(units, opts, &cache);
+            Assembler program;
+            link_modules(modules, program);
+            if (opts.opt_level >= 1) eliminate_dead_functions(program, false);
+            VM vm(program, &sm);
+            run_program(vm, program, flags);
         } catch (std::exception& e) {
             return 1;
         }
@@ -0,0 +1,65 @@
+#include "memo_cache.h"
+#include <string_view>
+
+MemoCache::~MemoCache() {
+    for (Entry& e : entries_) {
+        for (Value v : e.args) release(v);
+        release(e.result);
+    }
+}
+
+uint64_t MemoCache::hash_args(const Value* args, int argc) {
+    uint64_t h = 1469598103934665603ULL;
+    for (int i = 0; i < argc; ++i) {
+        const Value& v = args[i];
+        uint64_t part = v.raw;
+        if (v.is_obj() && v.as_obj() && v.as_obj()->type == OBJ_STRING)
+            part = std::hash<std::string_view>{}(((ObjString*)v.as_obj())->view());
+        h = (h ^ part) * 1099511628211ULL;
+    }
+    return h;
+}
+
+std::list<MemoCache::Entry>::iterator MemoCache::find(uint64_t hash, const Value* args, int argc) {
+    auto [first, last] = index_.equal_range(hash);
+    for (auto it = first; it != last; ++it) {
+        const Entry& e = *it->second;
+        if ((int)e.args.size() != argc) continue;
+        bool same = true;
+        for (int i = 0; i < argc && same; ++i) same = value_equal(e.args[i], args[i]);
+        if (same) return it->second;
+    }
+    return entries_.end();
+}
+
+const Value* MemoCache::lookup(const Value* args, int argc) {
+    auto it = find(hash_args(args, argc), args, argc);
+    if (it == entries_.end()) { stats_.misses++; return nullptr; }
+    stats_.hits++;
+    entries_.splice(entries_.begin(), entries_, it);
+    return &it->result;
+}
+
+void MemoCache::drop(std::list<Entry>::iterator it) {
+    auto [first, last] = index_.equal_range(it->hash);
+    for (auto ix = first; ix != last; ++ix)
+        if (ix->second == it) { index_.erase(ix); break; }
+    for (Value v : it->args) release(v);
+    release(it->result);
+    entries_.erase(it);
+}
+
+void MemoCache::insert(const Value* args, int argc, Value result) {
+    if (capacity_ == 0) return;
+    uint64_t hash = hash_args(args, argc);
+    // a recursive call with the same arguments may have got there first
+    auto it = find(hash, args, argc);
+    if (it != entries_.end()) drop(it);
+    if (entries_.size() >= capacity_) { drop(std::prev(entries_.end())); stats_.evictions++; }
+
+    Entry e{hash, std::vector<Value>(args, args + argc), result};
+    for (Value v : e.args) retain(v);
+    retain(result);
+    entries_.push_front(std::move(e));
+    index_.emplace(hash, entries_.begin());
+}
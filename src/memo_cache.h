@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "value.h"
+
+// results of one memo function (OP_CALL_MEMO) keyed by its arguments, compared like
+// value_equal: numbers by value, strings by content, other objects by identity. Holds at
+// most `capacity` entries and drops the least recently used one first.
+class MemoCache {
+public:
+    struct Stats { uint64_t hits = 0, misses = 0, evictions = 0; };
+
+    explicit MemoCache(size_t capacity) : capacity_(capacity) {}
+    MemoCache(const MemoCache&) = delete;
+    MemoCache& operator=(const MemoCache&) = delete;
+    ~MemoCache();
+
+    // what an earlier call with these arguments returned, nullptr on a miss
+    const Value* lookup(const Value* args, int argc);
+    // remembers the result of a call that missed
+    void insert(const Value* args, int argc, Value result);
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    struct Entry { uint64_t hash; std::vector<Value> args; Value result; };
+
+    size_t capacity_;
+    std::list<Entry> entries_;   // most recently used first
+    std::unordered_multimap<uint64_t, std::list<Entry>::iterator> index_;
+    Stats stats_;
+
+    static uint64_t hash_args(const Value* args, int argc);
+    std::list<Entry>::iterator find(uint64_t hash, const Value* args, int argc);
+    void drop(std::list<Entry>::iterator it);
+};
@@ -0,0 +1,97 @@
+#include "output.h"
+#include "value.h"
+#include <cmath>
+#include <cstdio>
+#include <unistd.h>
+
+namespace {
+    thread_local OutputBuffer* current_buffer = nullptr;
+}
+
+OutputBuffer::OutputBuffer(int fd) : buf_(new char[CAPACITY]), fd_(fd), line_flush_(isatty(fd)) {}
+
+void OutputBuffer::write_through(std::string_view s) {
+    // whatever went through stdio before has to come first
+    if (fd_ == STDOUT_FILENO) std::fflush(stdout);
+    while (!s.empty()) {
+        ssize_t n = ::write(fd_, s.data(), s.size());
+        if (n <= 0) return;
+        s.remove_prefix((size_t)n);
+    }
+}
+
+void OutputBuffer::flush() {
+    if (len_ == 0) return;
+    write_through({buf_.get(), len_});
+    len_ = 0;
+}
+
+OutputBuffer& OutputBuffer::current() {
+    static OutputBuffer process_wide;
+    return current_buffer ? *current_buffer : process_wide;
+}
+
+OutputBuffer::Scope::Scope(OutputBuffer& out) : prev_(current_buffer) { current_buffer = &out; }
+OutputBuffer::Scope::~Scope() { current_buffer = prev_; }
+
+bool parse_intscaled(std::string_view text, int64_t& q) {
+    size_t i = 0, n = text.size();
+    bool neg = false;
+    if (i < n && (text[i] == '-' || text[i] == '+')) neg = text[i++] == '-';
+
+    int64_t whole = 0;
+    size_t int_digits = 0;
+    for (; i < n && text[i] >= '0' && text[i] <= '9'; ++i, ++int_digits) whole = whole * 10 + (text[i] - '0');
+    if (int_digits > 18) return false;
+
+    uint64_t frac = 0, pow10 = 1;
+    size_t frac_digits = 0;
+    if (i < n && text[i] == '.') {
+        for (++i; i < n && text[i] >= '0' && text[i] <= '9'; ++i, ++frac_digits) {
+            if (frac_digits < 9) { frac = frac * 10 + (uint64_t)(text[i] - '0'); pow10 *= 10; }
+        }
+    }
+    if (i != n || int_digits + frac_digits == 0) return false;
+
+    uint64_t frac_q = (uint64_t)llroundl((long double)frac * (long double)INTSCALED_ONE / (long double)pow10);
+    int64_t mag = (whole << INTSCALED_SHIFT) + (int64_t)frac_q;
+    q = neg ? -mag : mag;
+    return true;
+}
+
+size_t format_intscaled(int64_t q, char* out) {
+    char* p = out;
+    uint64_t mag = q < 0 ? 0 - (uint64_t)q : (uint64_t)q;
+    if (q < 0) *p++ = '-';
+
+    // the double print used to format keeps 53 significant bits, rounded to nearest even
+    int bits = 64 - __builtin_clzll(mag | 1);
+    if (bits > 53) {
+        int shift = bits - 53;
+        uint64_t kept = mag >> shift, rest = mag & ((UINT64_C(1) << shift) - 1), half = UINT64_C(1) << (shift - 1);
+        if (rest > half || (rest == half && (kept & 1))) kept++;
+        mag = kept << shift;
+    }
+
+    // six decimals of the 32-bit fraction, ties to even like printf
+    uint64_t whole = mag >> 32;
+    uint64_t scaled = (mag & 0xFFFFFFFFu) * 1000000u;
+    uint64_t frac = scaled >> 32, rem = scaled & 0xFFFFFFFFu;
+    if (rem > 0x80000000u || (rem == 0x80000000u && (frac & 1))) frac++;
+    if (frac == 1000000) { frac = 0; whole++; }
+
+    char digits[20];
+    int n = 0;
+    do { digits[n++] = (char)('0' + whole % 10); whole /= 10; } while (whole);
+    while (n) *p++ = digits[--n];
+
+    if (frac) {
+        *p++ = '.';
+        char dec[6];
+        for (int i = 5; i >= 0; --i) { dec[i] = (char)('0' + frac % 10); frac /= 10; }
+        int keep = 6;
+        while (dec[keep - 1] == '0') keep--;
+        for (int i = 0; i < keep; ++i) *p++ = dec[i];
+    }
+    return (size_t)(p - out);
+}
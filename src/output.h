@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+// a program's stdout, or a file it writes: bytes collect here and reach the descriptor when the
+// buffer fills, on flush and, if it is a terminal, at the end of every line
+class OutputBuffer {
+public:
+    explicit OutputBuffer(int fd = 1);
+    ~OutputBuffer() { flush(); }
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    void write(std::string_view s) {
+        if (s.size() > CAPACITY - len_) {
+            flush();
+            if (s.size() > CAPACITY) { write_through(s); return; }
+        }
+        std::char_traits<char>::copy(buf_.get() + len_, s.data(), s.size());
+        len_ += s.size();
+    }
+    void put(char c) {
+        if (len_ == CAPACITY) flush();
+        buf_[len_++] = c;
+    }
+    void end_line() {
+        put('\n');
+        if (line_flush_) flush();
+    }
+    void flush();
+
+    // the buffer of the VM running on this thread, or a process-wide one
+    static OutputBuffer& current();
+
+    // makes a buffer current for its lifetime
+    class Scope {
+    public:
+        explicit Scope(OutputBuffer& out);
+        ~Scope();
+    private:
+        OutputBuffer* prev_;
+    };
+
+private:
+    static constexpr size_t CAPACITY = 1 << 16;
+    std::unique_ptr<char[]> buf_;
+    size_t len_ = 0;
+    int fd_;
+    bool line_flush_;
+
+    void write_through(std::string_view s);
+};
+
+// a 32.32 fixed-point number the way print shows it: printf("%.6f") of its double value with
+// trailing zeros and a trailing point dropped, without going through double or the heap.
+// `out` needs room for 32 bytes; returns the length.
+size_t format_intscaled(int64_t q, char* out);
+
+// the other way: [+-]digits[.digits] into 32.32 fixed point, fraction digits past the ninth
+// ignored. False for anything else, including integer parts of more than 18 digits.
+bool parse_intscaled(std::string_view text, int64_t& q);
@@ -4,42 +4,21 @@
 #include <cctype>
 #include <stdexcept>
 #include "value.h"
+#include <atomic>
 #include <cmath>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <thread>
 #include "builtin_registry.h"
-
-static int64_t parse_number_intscaled_from_lex(const std::string &lex) {
-    size_t pos = lex.find('.');
-    int64_t intpart = 0;
-    if (pos == std::string::npos) {
-        try { intpart = stoll(lex); } catch(...) { intpart = 0; }
-        return int64_t(intpart) << INTSCALED_SHIFT;
-    }
-    std::string s_int = lex.substr(0, pos);
-    std::string s_frac = lex.substr(pos+1);
-    if (!s_int.empty()) {
-        try { intpart = stoll(s_int); } catch(...) { intpart = 0; }
-    }
-    if (!s_frac.empty()) {
-        if ((int)s_frac.size() > 9) s_frac = s_frac.substr(0,9);
-        int frac_len = (int)s_frac.size();
-        uint64_t frac_int = 0;
-        try { frac_int = stoull(s_frac); } catch(...) { frac_int = 0; }
-        uint64_t pow10 = 1;
-        for (int i=0;i<frac_len;i++) pow10 *= 10ULL;
-        long double tmp = (long double)frac_int * (long double)(1ULL<<INTSCALED_SHIFT) / (long double)pow10;
-        uint64_t frac_q = (uint64_t) llround(tmp);
-        int64_t q = (int64_t(intpart) << INTSCALED_SHIFT) + (int64_t)frac_q;
-        return q;
-    }
-    return int64_t(intpart) << INTSCALED_SHIFT;
-}
+#include "output.h"
 
 static long long safe_as_intscaled(const Value &v) {
     if (!v.is_num()) return 0;
     return (long long) v.as_intscaled();
 }
 
-void Parser::tokenize_all(const std::string& src) {
+void Parser::tokenize_all(std::string_view src) {
     tokens_.clear();
     Lexer lx(src);
     while (true) {
@@ -77,13 +56,19 @@ void Parser::consume(TK k, const std::string& msg) {
     if (curr_.k == k) advance();
 }
 
-Parser::Parser(Compiler* owner, const std::string& src) : owner_(owner), src_text_(src) {
+Parser::Parser(Compiler* owner, std::string_view src) : owner_(owner), src_text_(src) {
     tokenize_all(src_text_);
     tokpos_ = 0;
     curr_ = tokens_.size()>0?tokens_[0]:Token{TK::END_FILE,"",0,0};
     next_ = tokens_.size()>1?tokens_[1]:Token{TK::END_FILE,"",0,0};
 }
 
+Parser::Parser(Compiler* owner, const Parser& unit) : owner_(owner), tokens_(unit.tokens_), src_text_(unit.src_text_) {
+    tokpos_ = 0;
+    curr_ = peek_token(0);
+    next_ = peek_token(1);
+}
+
 Parser::~Parser() {}
 
 void Parser::prescan_functions() {
@@ -94,14 +79,14 @@ void Parser::prescan_functions() {
             if (name.k == TK::IDENT) {
                 TypeKind maybe = parse_type_name(rett.lex);
                 int uid = -1;
-                if (maybe == TY_UNKNOWN) uid = owner_->find_item_id_by_name(rett.lex);
+                if (maybe == TY_UNKNOWN) uid = owner_->find_item_id_by_name(std::string(rett.lex));
                 if (maybe != TY_UNKNOWN || uid >= 0) {
                     FunctionSig fs;
                     fs.name = name.lex;
                     fs.return_type = maybe;
                     fs.declared_line = name.line;
                     fs.label_id = owner_->asm_.make_label();
-                    owner_->function_table_[fs.name].push_back(fs);
+                    owner_->function_table_.add(fs);
                 }
             }
         }
@@ -137,6 +122,7 @@ ExprResult Parser::compile_expr(int min_prec) {
 
 ExprResult Parser::compile_expr_internal(int min_prec) {
     ExprResult left = compile_atom_internal();
+    std::vector<ExprResult> concat;   // operands of a pending string + chain, left stands for its result
     while (true) {
         TK op = curr_.k;
         int prec = 0; OpCode opcode = OP_ADD;
@@ -148,6 +134,26 @@ ExprResult Parser::compile_expr_internal(int min_prec) {
         advance();
         ExprResult right = compile_expr_internal(prec + 1);
 
+        if (opcode == OP_ADD && left.type == TY_STRING && right.type == TY_STRING) {
+            if (concat.empty()) concat.push_back(left);
+            concat.push_back(right);
+            left = ExprResult::make_reg(-1, TY_STRING);
+            continue;
+        }
+        if (!concat.empty()) { left = emit_concat(concat, curr_.line); concat.clear(); }
+
+        // a list on either side, the other a list or a number: one instruction for the whole list
+        auto list_or_number = [](TypeKind t) { return t == TY_LIST || t == TY_NUMBER; };
+        if (vector_list_op(opcode) != opcode && (left.type == TY_LIST || right.type == TY_LIST) &&
+            list_or_number(left.type) && list_or_number(right.type)) {
+            int left_reg = ensure_reg(left, curr_.line);
+            int right_reg = ensure_reg(right, curr_.line);
+            int dest = owner_->define_local("", TY_LIST);
+            owner_->asm_.emit(vector_list_op(opcode), curr_.line, dest, left_reg, right_reg);
+            left = ExprResult::make_reg(dest, TY_LIST);
+            continue;
+        }
+
         if (left.is_const && right.is_const) {
             if ((opcode==OP_ADD||opcode==OP_SUB||opcode==OP_MUL||opcode==OP_DIV) &&
                 left.const_value.is_num() && right.const_value.is_num()) {
@@ -158,10 +164,10 @@ ExprResult Parser::compile_expr_internal(int min_prec) {
                 switch (opcode) {
                     case OP_ADD: resq = n1 + n2; break;
                     case OP_SUB: resq = n1 - n2; break;
-                    case OP_MUL: resq = n1 * n2; break;
+                    case OP_MUL: resq = intscaled_mul(n1, n2); break;
                     case OP_DIV:
                         if (n2 == 0) ok = false;
-                        else resq = n1 / n2;
+                        else resq = intscaled_div(n1, n2);
                         break;
                     default: ok = false; break;
                 }
@@ -209,20 +215,58 @@ ExprResult Parser::compile_expr_internal(int min_prec) {
         if (opcode==OP_ADD || opcode==OP_SUB || opcode==OP_MUL || opcode==OP_DIV) result_t = TY_NUMBER;
         else if (opcode==OP_LT || opcode==OP_GT || opcode==OP_EQ) result_t = TY_BOOL;
 
+        // both sides statically numbers: the VM can skip the operand checks
+        if (left.type == TY_NUMBER && right.type == TY_NUMBER) opcode = typed_number_op(opcode);
+
         int dest = owner_->define_local("", result_t);
         owner_->asm_.emit(opcode, curr_.line, dest, left_reg, right_reg);
 
         left = ExprResult::make_reg(dest, result_t);
     }
 
+    if (!concat.empty()) left = emit_concat(concat, curr_.line);
     return left;
 }
 
+ExprResult Parser::emit_concat(const std::vector<ExprResult> &parts, int line) {
+    auto text_of = [](const ExprResult &p) -> const std::string* {
+        if (!p.is_const || !p.const_value.is_obj() || p.const_value.as_obj()->type != OBJ_STRING) return nullptr;
+        return &((ObjString*)p.const_value.as_obj())->str;
+    };
+    std::vector<ExprResult> merged;
+    for (const ExprResult &p : parts) {
+        const std::string* t = text_of(p);
+        const std::string* prev = merged.empty() ? nullptr : text_of(merged.back());
+        if (t && prev) merged.back() = ExprResult::make_const(Value::make_obj(new ObjString(*prev + *t)), TY_STRING);
+        else merged.push_back(p);
+    }
+    if (merged.size() == 1) return merged[0];
+
+    if (merged.size() == 2) {
+        int l = ensure_reg(merged[0], line);
+        int r = ensure_reg(merged[1], line);
+        int dest = owner_->define_local("", TY_STRING);
+        owner_->asm_.emit(OP_CONCAT, line, dest, l, r);
+        return ExprResult::make_reg(dest, TY_STRING);
+    }
+
+    // a + b + c + ...: one OP_CONCAT_N sizes the result once instead of copying every prefix
+    std::vector<int> regs;
+    for (ExprResult &p : merged) regs.push_back(ensure_reg(p, line));
+    int dest = owner_->define_local("", TY_STRING);
+    for (size_t i = 0; i < regs.size(); ++i) {
+        int slot = owner_->define_local("", TY_STRING);
+        owner_->asm_.emit(OP_MOVE, line, slot, regs[i]);
+    }
+    owner_->asm_.emit(OP_CONCAT_N, line, dest, 0, (int)regs.size());
+    return ExprResult::make_reg(dest, TY_STRING);
+}
+
 ExprResult Parser::compile_atom_internal() {
     int line = curr_.line;
 
     if (curr_.k == TK::TK_BAD) {
-        owner_->push_diag(std::string("Unknown token: '") + curr_.lex + std::string("'"),
+        owner_->push_diag("Unknown token: '" + std::string(curr_.lex) + "'",
                           {curr_.line, curr_.col, (int)curr_.lex.size()}, owner_->current_function_);
         advance();
         int r = owner_->define_local("", TY_UNKNOWN);
@@ -232,13 +276,14 @@ ExprResult Parser::compile_atom_internal() {
     }
 
     if (curr_.k == TK::NUMBER) {
-        int64_t q = parse_number_intscaled_from_lex(curr_.lex);
+        int64_t q = 0;
+        parse_intscaled(curr_.lex, q);
         advance();
         return ExprResult::make_const(Value::make_intscaled(q), TY_NUMBER);
     }
 
     if (curr_.k == TK::STRING) {
-        ObjString* s = new ObjString(curr_.lex); advance();
+        ObjString* s = new ObjString(unescape_string(curr_.lex)); advance();
         return ExprResult::make_const(Value::make_obj(s), TY_STRING);
     }
     if (curr_.k == TK::BOOL) {
@@ -269,37 +314,21 @@ ExprResult Parser::compile_atom_internal() {
     }
 
     if (curr_.k == TK::IDENT) {
-        std::string name = curr_.lex; advance();
+        std::string name(curr_.lex); advance();
 
         // function call: ident '(' ...
         if (curr_.k == TK::LP) {
-            advance();
             std::vector<int> arg_regs;
             std::vector<TypeKind> arg_types;
-            std::vector<ExprResult> arg_exprs;
-            if (curr_.k != TK::RP) {
-                while (true) {
-                    ExprResult p = compile_expr_internal();
-                    arg_exprs.push_back(p);
-                    if (curr_.k == TK::COMMA) { advance(); continue; }
-                    break;
-                }
-            }
-            consume(TK::RP, "Expected ')'");
-            for (auto &er : arg_exprs) {
-                int r = ensure_reg(er, line);
-                arg_regs.push_back(r);
-                arg_types.push_back(er.type);
-            }
+            compile_call_args(line, arg_regs, arg_types);
 
             FunctionSig* fs = owner_->resolve_function(name, arg_types);
             if (!fs) {
                 std::string hint = "Unknown function or invalid overload: " + name;
-                auto it = owner_->function_table_.find(name);
-                if (it != owner_->function_table_.end()) {
+                if (const Overloads* o = owner_->function_table_.find(name)) {
                     hint += ". Available overloads: ";
                     bool first = true;
-                    for (auto &ofs : it->second) {
+                    for (auto &ofs : o->sigs) {
                         if (!first) hint += " | ";
                         first = false;
                         hint += ofs.name + "(";
@@ -328,7 +357,7 @@ ExprResult Parser::compile_atom_internal() {
                 return ExprResult::make_reg(dest, TY_ITEM);
             }
             if (fs->is_builtin) {
-                int bid = BuiltinRegistry::lookup_name(fs->name);
+                int bid = BuiltinRegistry::lookup_name(fs->name, fs->param_types);
                 ObjFunction* of = new ObjFunction(bid, fs->return_type, fs->param_types, fs->name);
                 int func_reg = owner_->emit_const(Value::make_obj(of), line);
 
@@ -352,6 +381,11 @@ ExprResult Parser::compile_atom_internal() {
             return ExprResult::make_reg(dest, fs->return_type);
         }
 
+        // alias.fn(...): call into an imported unit
+        if (curr_.k == TK::DOT && next_.k == TK::IDENT && peek_token(2).k == TK::LP &&
+            owner_->resolve_local(name) == -1 && owner_->imports.count(name))
+            return compile_import_call(name, line);
+
         int loc = owner_->resolve_local(name);
         if (loc == -1) {
             owner_->push_diag("Undefined variable: " + name, {line, curr_.col, (int)name.size()}, owner_->current_function_);
@@ -401,7 +435,7 @@ ExprResult Parser::compile_atom_internal() {
             if (curr_.k == TK::DOT) {
                 advance();
                 if (curr_.k == TK::IDENT) {
-                    std::string member = curr_.lex;
+                    std::string member(curr_.lex);
                     advance();
 
                     int base_user_id = -1;
@@ -434,7 +468,7 @@ ExprResult Parser::compile_atom_internal() {
                     continue;
                 } else if (curr_.k == TK::NUMBER) {
                     long long idxval = 0;
-                    try { idxval = stoll(curr_.lex); } catch(...) { idxval = 0; }
+                    try { idxval = stoll(std::string(curr_.lex)); } catch(...) { idxval = 0; }
                     advance();
                     int idxreg = owner_->emit_const(Value::make_int(idxval - 1), line);
                     int dest = owner_->define_local("", TY_UNKNOWN);
@@ -456,7 +490,7 @@ ExprResult Parser::compile_atom_internal() {
                 int preg = ensure_reg(p, line);
                 consume(TK::RBRACK, "Expected ')'");
                 int negone = owner_->emit_const(Value::make_int(-1), line);
-                owner_->asm_.emit(OP_ADD, line, preg, preg, negone);
+                owner_->asm_.emit(p.type == TY_NUMBER ? OP_ADD_NN : OP_ADD, line, preg, preg, negone);
                 int dest = owner_->define_local("", TY_UNKNOWN);
 
                 if (tmp >= 0 && tmp < (int)owner_->locals_.size() && owner_->locals_[tmp].type == TY_LIST) 
@@ -486,11 +520,205 @@ ExprResult Parser::compile_atom_internal() {
     return ExprResult::make_reg(r, TY_UNKNOWN);
 }
 
+void Parser::compile_call_args(int line, std::vector<int>& arg_regs, std::vector<TypeKind>& arg_types) {
+    advance();
+    std::vector<ExprResult> arg_exprs;
+    if (curr_.k != TK::RP) {
+        while (true) {
+            ExprResult p = compile_expr_internal();
+            arg_exprs.push_back(p);
+            if (curr_.k == TK::COMMA) { advance(); continue; }
+            break;
+        }
+    }
+    consume(TK::RP, "Expected ')'");
+    for (auto &er : arg_exprs) {
+        int r = ensure_reg(er, line);
+        arg_regs.push_back(r);
+        arg_types.push_back(er.type);
+    }
+}
+
+ExprResult Parser::compile_import_call(const std::string& alias, int line) {
+    const ImportedUnit& unit = owner_->imports.at(alias);
+    advance(); // '.'
+    std::string name(curr_.lex);
+    advance();
+
+    std::vector<int> arg_regs;
+    std::vector<TypeKind> arg_types;
+    compile_call_args(line, arg_regs, arg_types);
+
+    // same matching rules as Compiler::resolve_function
+    int chosen = -1;
+    for (int i = 0; i < (int)unit.exports.size() && chosen < 0; ++i) {
+        const ExportSig& e = unit.exports[i];
+        if (e.name != name || e.param_types.size() != arg_types.size()) continue;
+        bool ok = true;
+        for (size_t k = 0; k < arg_types.size() && ok; ++k)
+            ok = arg_types[k] == TY_UNKNOWN || e.param_types[k] == TY_UNKNOWN || e.param_types[k] == arg_types[k];
+        if (ok) chosen = i;
+    }
+    if (chosen < 0) {
+        owner_->push_diag("Unknown function or invalid overload: " + alias + "." + name, {line, 1, (int)name.size()}, owner_->current_function_);
+        int r = owner_->emit_const(Value::make_nil(), line);
+        return ExprResult::make_reg(r, TY_UNKNOWN);
+    }
+    const ExportSig& e = unit.exports[chosen];
+
+    int slot = -1;
+    for (int i = 0; i < (int)owner_->import_calls.size() && slot < 0; ++i)
+        if (owner_->import_calls[i].unit == unit.unit && owner_->import_calls[i].export_index == chosen) slot = i;
+    if (slot < 0) {
+        slot = (int)owner_->import_calls.size();
+        owner_->import_calls.push_back({unit.unit, chosen});
+    }
+
+    int dest = owner_->define_local("", e.return_type);
+    std::vector<int> call_arg_slots;
+    for (size_t i = 0; i < arg_regs.size(); ++i) call_arg_slots.push_back(owner_->define_local("", e.param_types[i]));
+    for (size_t i = 0; i < arg_regs.size(); ++i)
+        owner_->asm_.emit(OP_MOVE, line, call_arg_slots[i], arg_regs[i]);
+    owner_->asm_.emit(OP_CALL, line, dest, import_call_ref(slot), (int)arg_regs.size());
+    return ExprResult::make_reg(dest, e.return_type);
+}
+
+// leaves curr_ after the 'end' (or '}') closing the body that starts at curr_
+void Parser::skip_function_body() {
+    if (curr_.k == TK::LBRACE) advance();
+    int depth = 0;
+    while (curr_.k != TK::END_FILE) {
+        TK k = curr_.k;
+        if (k == TK::KEY_END || k == TK::RBRACE) {
+            if (depth == 0) { advance(); return; }
+            if (k == TK::KEY_END) depth--;
+        }
+        // "else if" shares the 'end' of the if it continues
+        else if ((k == TK::IF && peek_token(-1).k != TK::ELSE) || k == TK::WHILE) depth++;
+        advance();
+    }
+}
+
+Parser::FunctionBody Parser::compile_function_body(const FunctionJob& job) {
+    owner_->asm_ = Assembler();
+    calls_.clear();
+    owner_->locals_.clear();
+    owner_->scope_depth_ = 0;
+    owner_->diagnostics_.clear();
+    owner_->import_calls.clear();
+    owner_->current_function_ = job.name;
+
+    tokpos_ = job.body_tok;
+    curr_ = peek_token(0);
+    next_ = peek_token(1);
+    {
+        ScopeGuard sg(owner_);
+        for (size_t i = 0; i < job.param_names.size(); ++i) {
+            int uid = (i < job.param_user_ids.size()) ? job.param_user_ids[i] : -1;
+            owner_->define_local(job.param_names[i], job.param_types[i], uid);
+        }
+
+        if (curr_.k == TK::LBRACE) advance();
+        while (curr_.k != TK::KEY_END && curr_.k != TK::RBRACE && curr_.k != TK::END_FILE) compile_stmt();
+        if (curr_.k == TK::RBRACE) advance(); else consume(TK::KEY_END, "Expected 'end' token after function");
+
+        int nilreg = owner_->emit_const(Value::make_nil(), curr_.line);
+        owner_->asm_.emit(OP_RETURN, curr_.line, nilreg);
+    }
+    owner_->current_function_.clear();
+    return {std::move(owner_->asm_), std::move(calls_), std::move(owner_->diagnostics_), std::move(owner_->import_calls)};
+}
+
+void Parser::compile_function_bodies(std::vector<FunctionJob>& jobs) {
+    // bodies only read the unit's tables, so each worker compiles into its own fragment
+    std::vector<FunctionBody> bodies(jobs.size());
+    std::atomic<size_t> next{0};
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto worker = [&]() {
+        try {
+            Compiler local(*owner_);
+            for (size_t n; (n = next++) < jobs.size();)
+                bodies[n] = local.parser_->compile_function_body(jobs[n]);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) error = std::current_exception();
+        }
+    };
+    // a thread only pays off with a few dozen bodies to share
+    size_t workers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), jobs.size() / 32 + 1);
+    std::vector<std::thread> pool;
+    for (size_t w = 1; w < workers; ++w) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+    if (error) std::rethrow_exception(error);
+
+    // splice the fragments in source order: local pcs and constants get rebased, calls to
+    // functions resolve through the unit's labels
+    Assembler& as = owner_->asm_;
+    std::vector<Diagnostic> diags;
+    int header_diag = 0;
+    for (size_t n = 0; n < jobs.size(); ++n) {
+        FunctionBody& body = bodies[n];
+        const FunctionJob& job = jobs[n];
+        diags.insert(diags.end(), owner_->diagnostics_.begin() + header_diag, owner_->diagnostics_.begin() + job.diag_mark);
+        diags.insert(diags.end(), body.diagnostics.begin(), body.diagnostics.end());
+        header_diag = job.diag_mark;
+
+        as.bind_label(job.label);
+        int base = (int)as.code.size();
+        std::vector<int> const_map(body.as.constants.size());
+        for (size_t k = 0; k < body.as.constants.size(); ++k) const_map[k] = as.add_constant(body.as.constants[k]);
+        for (Instr ins : body.as.code) {
+            if (ins.op == OP_CONST) ins.b = const_map[ins.b];
+            else if (op_has_pc_target(ins.op) && ins.b >= 0) ins.b += base;
+            else if (op_calls_pc(ins.op) && ins.b < -1) {
+                const ImportCall& ic = body.import_calls[import_call_slot(ins.b)];
+                int slot = -1;
+                for (int i = 0; i < (int)owner_->import_calls.size() && slot < 0; ++i)
+                    if (owner_->import_calls[i].unit == ic.unit && owner_->import_calls[i].export_index == ic.export_index) slot = i;
+                if (slot < 0) { slot = (int)owner_->import_calls.size(); owner_->import_calls.push_back(ic); }
+                ins.b = import_call_ref(slot);
+            }
+            as.code.push_back(ins);
+        }
+        for (auto [ref, label] : body.calls) {
+            int pc = base + ref;
+            if (as.labels[label].target_pc >= 0) as.code[pc].b = as.labels[label].target_pc;
+            else as.labels[label].refs.push_back(pc);
+        }
+
+        int end_label = as.make_label();
+        as.bind_label(end_label);
+        as.functions.push_back({job.name, job.label, end_label});
+    }
+    diags.insert(diags.end(), owner_->diagnostics_.begin() + header_diag, owner_->diagnostics_.end());
+    owner_->diagnostics_ = std::move(diags);
+}
+
+// a cached result is only right when nothing but the arguments decides it
+void Parser::check_memo_functions() {
+    const Assembler& as = owner_->asm_;
+    std::vector<char> pure;
+    for (size_t f = 0; f < as.functions.size(); ++f) {
+        const FuncInfo& fi = as.functions[f];
+        FunctionSig* fs = owner_->function_table_.find_label(fi.name, fi.entry_label);
+        if (!fs || !fs->memo) continue;
+        if (pure.empty()) pure = as.pure_functions();
+        if (!pure[f])
+            owner_->push_diag("Function '" + fi.name + "' is declared memo but is not pure", {fs->declared_line, 0, 0}, fi.name);
+    }
+}
+
 void Parser::compile_unit(SourceManager* sm) {
     prescan_functions();
 
-    int entry_label = owner_->asm_.make_label();
-    owner_->asm_.emit_jump(OP_JMP, 0, 0, entry_label);
+    // libraries have no entry point, their code starts with the first function
+    int entry_label = -1;
+    if (!owner_->is_library) {
+        entry_label = owner_->asm_.make_label();
+        owner_->asm_.emit_jump(OP_JMP, 0, 0, entry_label);
+    }
 
     if (curr_.k != TK::UNIT) {
         owner_->push_diag("Expected 'unit' at the beginning", {curr_.line, curr_.col, (int)curr_.lex.size()}, "");
@@ -501,14 +729,19 @@ void Parser::compile_unit(SourceManager* sm) {
         owner_->push_diag("Expected unit name", {curr_.line, curr_.col, (int)curr_.lex.size()}, "");
         return;
     }
-    std::string unit_name = curr_.lex;
+    std::string unit_name(curr_.lex);
     advance();
 
     if (curr_.k == TK::COLON) {
         advance();
         while (curr_.k == TK::IDENT) {
+            Token dep = curr_;
+            std::string alias(dep.lex);
             advance();
-            if (curr_.k == TK::AS) { advance(); if (curr_.k == TK::IDENT) advance(); }
+            if (curr_.k == TK::AS) { advance(); if (curr_.k == TK::IDENT) { alias = curr_.lex; advance(); } }
+            auto it = owner_->imports.find(alias);
+            if (it == owner_->imports.end() || it->second.unit != dep.lex)
+                owner_->push_diag("Unit not found: " + std::string(dep.lex), {dep.line, dep.col, (int)dep.lex.size()}, "");
             if (curr_.k == TK::COMMA) { advance(); continue; }
             break;
         }
@@ -516,7 +749,14 @@ void Parser::compile_unit(SourceManager* sm) {
 
     consume(TK::LBRACE, "Expected '{' token after unit header");
 
+    std::vector<FunctionJob> jobs;
+    std::set<int> claimed;   // function labels already given to a definition
     while (curr_.k != TK::RBRACE && curr_.k != TK::END_FILE) {
+        bool memo = curr_.k == TK::MEMO;
+        if (memo) {
+            advance();
+            if (curr_.k != TK::ON) owner_->push_diag("Expected 'on' after 'memo'", {curr_.line, curr_.col, (int)curr_.lex.size()}, "");
+        }
         if (curr_.k == TK::ON) {
             advance();
             if (curr_.k != TK::IDENT) {
@@ -524,7 +764,7 @@ void Parser::compile_unit(SourceManager* sm) {
                 break;
             }
 
-            std::string rett_tok = curr_.lex;
+            std::string rett_tok(curr_.lex);
             auto [rett_kind, rett_user_id] = resolve_type_name(rett_tok);
             if (rett_kind == TY_UNKNOWN) owner_->push_diag("Unknown return type: " + rett_tok, {curr_.line, curr_.col, (int)curr_.lex.size()}, "");
             advance();
@@ -533,26 +773,28 @@ void Parser::compile_unit(SourceManager* sm) {
                 owner_->push_diag("Expected function name after type", {curr_.line, curr_.col, (int)curr_.lex.size()}, "");
                 break;
             }
-            std::string fname = curr_.lex;
+            std::string fname(curr_.lex);
             advance();
 
             int chosen = -1;
-            auto &vec = owner_->function_table_[fname];
-            for (auto &fs : vec) {
-                if (fs.label_id >= 0 && fs.label_id < (int)owner_->asm_.labels.size() && owner_->asm_.labels[fs.label_id].target_pc == -1) {
-                    chosen = fs.label_id;
-                    break;
+            if (Overloads* o = owner_->function_table_.find(fname))
+                for (auto &fs : o->sigs) {
+                    if (fs.label_id >= 0 && fs.label_id < (int)owner_->asm_.labels.size() && !claimed.count(fs.label_id)) {
+                        chosen = fs.label_id;
+                        break;
+                    }
                 }
-            }
             if (chosen == -1) {
                 chosen = owner_->asm_.make_label();
                 FunctionSig fs; fs.name = fname; fs.label_id = chosen; fs.return_type = rett_kind; fs.declared_line = curr_.line;
                 fs.user_return_type_id = rett_user_id;
-                owner_->function_table_[fname].push_back(fs);
-            } else
-                for (auto &fs : owner_->function_table_[fname]) if (fs.label_id == chosen) { fs.return_type = rett_kind; fs.user_return_type_id = rett_user_id; break; }
+                owner_->function_table_.add(fs);
+            } else if (FunctionSig* fs = owner_->function_table_.find_label(fname, chosen)) {
+                fs->return_type = rett_kind;
+                fs->user_return_type_id = rett_user_id;
+            }
 
-            owner_->asm_.bind_label(chosen);
+            claimed.insert(chosen);
             owner_->current_function_ = fname;
 
             consume(TK::LP, "Expected '(' token after function name");
@@ -565,7 +807,7 @@ void Parser::compile_unit(SourceManager* sm) {
                         owner_->push_diag("Expected param name", {curr_.line, curr_.col, (int)curr_.lex.size()}, owner_->current_function_);
                         break;
                     }
-                    std::string pname = curr_.lex;
+                    std::string pname(curr_.lex);
                     advance();
                     consume(TK::COLON, "Expected ':' token after param name");
                     if (curr_.k != TK::IDENT) {
@@ -573,7 +815,7 @@ void Parser::compile_unit(SourceManager* sm) {
                         break;
                     }
 
-                    std::string ptype_tok = curr_.lex;
+                    std::string ptype_tok(curr_.lex);
                     auto [pk, puid] = resolve_type_name(ptype_tok);
                     if (pk == TY_UNKNOWN) owner_->push_diag("Unknown type for the param: " + ptype_tok, {curr_.line,curr_.col,(int)ptype_tok.size()}, owner_->current_function_);
                     advance();
@@ -587,27 +829,16 @@ void Parser::compile_unit(SourceManager* sm) {
             }
             consume(TK::RP, "Expected ')'");
 
-            for (auto &fs : owner_->function_table_[fname]) if (fs.label_id == chosen) {
-                fs.param_types = ptypes;
-                fs.return_type = rett_kind;
-                fs.user_return_type_id = rett_user_id;
-                break;
+            if (FunctionSig* fs = owner_->function_table_.find_label(fname, chosen)) {
+                owner_->function_table_.set_params(*fs, ptypes);
+                fs->return_type = rett_kind;
+                fs->user_return_type_id = rett_user_id;
+                fs->memo = memo;
             }
 
-            {
-                ScopeGuard sg(owner_);
-                for (size_t i = 0; i < pnames.size(); ++i) {
-                    int uid = (i < puserids.size()) ? puserids[i] : -1;
-                    owner_->define_local(pnames[i], ptypes[i], uid);
-                }
-
-                if (curr_.k == TK::LBRACE) advance();
-                while (curr_.k != TK::KEY_END && curr_.k != TK::RBRACE && curr_.k != TK::END_FILE) compile_stmt();
-                if (curr_.k == TK::RBRACE) advance(); else consume(TK::KEY_END, "Expected 'end' token after function");
-
-                int nilreg = owner_->emit_const(Value::make_nil(), curr_.line);
-                owner_->asm_.emit(OP_RETURN, curr_.line, nilreg);
-            }
+            // the body is compiled later, once every signature in the unit is known
+            jobs.push_back({fname, chosen, pnames, ptypes, puserids, tokpos_, (int)owner_->diagnostics_.size()});
+            skip_function_body();
 
             owner_->current_function_.clear();
             continue;
@@ -616,7 +847,7 @@ void Parser::compile_unit(SourceManager* sm) {
         else if (curr_.k == TK::ITEM) {
             advance();
             if (curr_.k != TK::IDENT) { owner_->push_diag("Expected item name", {curr_.line,curr_.col,(int)curr_.lex.size()}, ""); break; }
-            std::string item_name = curr_.lex; advance();
+            std::string item_name(curr_.lex); advance();
             std::string parent_name;
             if (curr_.k == TK::COLON) {
                 advance();
@@ -627,14 +858,14 @@ void Parser::compile_unit(SourceManager* sm) {
             if (curr_.k != TK::RP) {
                 while (true) {
                     if (curr_.k != TK::IDENT) { owner_->push_diag("Expected field type", {curr_.line,curr_.col,(int)curr_.lex.size()}, ""); break; }
-                    std::string type_tok = curr_.lex; advance();
+                    std::string type_tok(curr_.lex); advance();
                     TypeKind ftk = parse_type_name(type_tok);
                     if (ftk == TY_UNKNOWN) {
                         int iid = owner_->find_item_id_by_name(type_tok);
                         if (iid >= 0) ftk = TY_TABLE; else owner_->push_diag("Unknown field type: " + type_tok, {curr_.line,curr_.col,(int)type_tok.size()}, "");
                     }
                     if (curr_.k != TK::IDENT) { owner_->push_diag("Expected field name", {curr_.line,curr_.col,(int)curr_.lex.size()}, ""); break; }
-                    std::string fname = curr_.lex; advance();
+                    std::string fname(curr_.lex); advance();
                     fields.push_back({fname, ftk});
                     if (curr_.k == TK::COMMA) { advance(); continue; }
                     break;
@@ -652,27 +883,34 @@ void Parser::compile_unit(SourceManager* sm) {
 
     consume(TK::RBRACE, "Expected '}' on unit's end");
 
-    owner_->asm_.bind_label(entry_label);
+    compile_function_bodies(jobs);
+    check_memo_functions();
 
-    std::vector<TypeKind> main_args;
-    FunctionSig* mainfs = owner_->resolve_function("main", main_args);
-    if (mainfs) {
-        if (mainfs->return_type == TY_VOID) {
-            int dummy = owner_->define_local("", TY_UNKNOWN);
-            owner_->asm_.emit_call(curr_.line, dummy, mainfs->label_id, mainfs->param_types.size());
-        }
-        else {
-            int dest = owner_->define_local("___main_ret", mainfs->return_type);
-            owner_->asm_.emit_call(curr_.line, dest, mainfs->label_id, mainfs->param_types.size());
+    if (!owner_->is_library) {
+        owner_->asm_.bind_label(entry_label);
+
+        std::vector<TypeKind> main_args;
+        FunctionSig* mainfs = owner_->resolve_function("main", main_args);
+        if (mainfs) {
+            if (mainfs->return_type == TY_VOID) {
+                int dummy = owner_->define_local("", TY_UNKNOWN);
+                owner_->asm_.emit_call(curr_.line, dummy, mainfs->label_id, mainfs->param_types.size());
+            }
+            else {
+                int dest = owner_->define_local("___main_ret", mainfs->return_type);
+                owner_->asm_.emit_call(curr_.line, dest, mainfs->label_id, mainfs->param_types.size());
+            }
         }
-    }
-    else owner_->push_diag("Function 'main' not found", {0,0,0}, "");
-    
+        else owner_->push_diag("Function 'main' not found", {0,0,0}, "");
 
-    int nilreg = owner_->emit_const(Value::make_nil(), curr_.line);
-    owner_->asm_.emit(OP_RETURN, curr_.line, nilreg);
+        int nilreg = owner_->emit_const(Value::make_nil(), curr_.line);
+        owner_->asm_.emit(OP_RETURN, curr_.line, nilreg);
+    }
 
     if (!owner_->diagnostics_.empty()) {
+        // units compile on several threads, keep each unit's report in one piece
+        static std::mutex report_mutex;
+        std::lock_guard<std::mutex> lock(report_mutex);
         if (sm) {
             for (auto &d : owner_->diagnostics_) sm->report("Compilation error", d.loc, d.msg);
             throw std::runtime_error(owner_->diagnostics_.front().msg);
@@ -688,7 +926,7 @@ void Parser::compile_stmt() {
     int line = curr_.line;
 
     if (curr_.k == TK::TK_BAD) {
-        owner_->push_diag(std::string("Unexpected token: '") + curr_.lex + std::string("'"),
+        owner_->push_diag("Unexpected token: '" + std::string(curr_.lex) + "'",
                           {curr_.line, curr_.col, (int)curr_.lex.size()}, owner_->current_function_);
         advance();
         return;
@@ -699,7 +937,7 @@ void Parser::compile_stmt() {
         Token nameTok = curr_;
         advance();
 
-        int loc = owner_->resolve_local(nameTok.lex);
+        int loc = owner_->resolve_local(std::string(nameTok.lex));
         if (loc != -1) {
             int tmp = owner_->define_local("", owner_->locals_[loc].type, owner_->locals_[loc].user_type_id);
             owner_->asm_.emit(OP_MOVE, line, tmp, loc);
@@ -712,14 +950,14 @@ void Parser::compile_stmt() {
                 if (curr_.k == TK::DOT) {
                     advance();
                     if (curr_.k != TK::IDENT) { failed_parse_chain = true; break; }
-                    std::string member = curr_.lex;
+                    std::string member(curr_.lex);
                     advance();
                     chain.push_back({ChainOp::DOT, member, -1});
                 } else {
                     advance();
                     ExprResult p = compile_expr_internal();
                     int preg = ensure_reg(p, line);
-                    owner_->asm_.emit(OP_ADD, line, preg, preg, owner_->emit_const(Value::make_int(-1), line));
+                    owner_->asm_.emit(p.type == TY_NUMBER ? OP_ADD_NN : OP_ADD, line, preg, preg, owner_->emit_const(Value::make_int(-1), line));
                     consume(TK::RBRACK, "Expected ']'");
                     chain.push_back({ChainOp::LBRACK, "", preg});
                 }
@@ -829,10 +1067,10 @@ void Parser::compile_stmt() {
     if (curr_.k == TK::IDENT && next_.k == TK::IDENT) {
         Token t3 = peek_token(2);
         if (t3.k == TK::ASSIGN) {
-            std::string type_tok = curr_.lex;
+            std::string type_tok(curr_.lex);
             auto [tk, tuid] = resolve_type_name(type_tok);
 
-            std::string var_name = next_.lex;
+            std::string var_name(next_.lex);
             advance(); // type
             advance(); // var name
             advance(); // =
@@ -859,7 +1097,7 @@ void Parser::compile_stmt() {
             if (curr_.k != TK::ASSIGN) advance();
             return;
         }
-        std::string name = curr_.lex; advance();
+        std::string name(curr_.lex); advance();
         consume(TK::ASSIGN, "Expected '=' after variable name");
         ExprResult rres = compile_expr_internal();
         int r = ensure_reg(rres, line);
@@ -869,7 +1107,7 @@ void Parser::compile_stmt() {
     }
 
     if (curr_.k == TK::IDENT && next_.k == TK::ASSIGN) {
-        std::string name = curr_.lex;
+        std::string name(curr_.lex);
         advance(); advance();
         ExprResult rres = compile_expr_internal();
         int r = ensure_reg(rres, line);
@@ -974,7 +1212,9 @@ int Parser::emit_call_helper(int line, FunctionSig* fs, const std::vector<int>&
     for (size_t i = 0; i < arg_regs.size(); ++i)
         owner_->asm_.emit(OP_MOVE, line, call_arg_slots[i], arg_regs[i]);
 
-    owner_->asm_.emit_call(line, dest, fs->label_id, (int)arg_regs.size());
+    // bodies are compiled apart from the unit, compile_function_bodies patches the target
+    int idx = owner_->asm_.emit(fs->memo ? OP_CALL_MEMO : OP_CALL, line, dest, -1, (int)arg_regs.size());
+    calls_.push_back({idx, fs->label_id});
     return dest;
 }
 
@@ -31,22 +31,46 @@ struct ExprResult {
 
 class Parser {
 public:
-    Parser(Compiler* owner, const std::string& src);
+    Parser(Compiler* owner, std::string_view src);
+    // shares the tokens of another unit's parser
+    Parser(Compiler* owner, const Parser& unit);
     ~Parser();
 
     // main entry
     void compile_unit(SourceManager* sm);
 
 private:
+    // a function whose header is parsed and whose body waits for compile_function_bodies
+    struct FunctionJob {
+        std::string name;
+        int label;
+        std::vector<std::string> param_names;
+        std::vector<TypeKind> param_types;
+        std::vector<int> param_user_ids;
+        int body_tok;
+        int diag_mark;   // header diagnostics of this and earlier functions
+    };
+    struct FunctionBody {
+        Assembler as;
+        std::vector<std::pair<int, int>> calls;   // pc of each OP_CALL and its function label
+        std::vector<Diagnostic> diagnostics;
+        std::vector<ImportCall> import_calls;
+    };
+    void skip_function_body();
+    FunctionBody compile_function_body(const FunctionJob& job);
+    void compile_function_bodies(std::vector<FunctionJob>& jobs);
+    void check_memo_functions();
+
     Compiler* owner_ = nullptr;
     std::vector<Token> tokens_;
     int tokpos_ = 0;
     Token curr_;
     Token next_;
-    std::string src_text_;
+    std::string_view src_text_;   // the owning Compiler's source; tokens point into it
+    std::vector<std::pair<int, int>> calls_;   // see FunctionBody::calls
 
     // tokenize
-    void tokenize_all(const std::string& src);
+    void tokenize_all(std::string_view src);
     Token peek_token(int lookahead = 0) const;
     void advance();
     void consume(TK k, const std::string& msg);
@@ -60,6 +84,8 @@ private:
     // internal helpers
     ExprResult compile_expr_internal(int min_prec = 0);
     ExprResult compile_atom_internal();
+    // joins the operands of a string + chain, neighbouring constants folded together
+    ExprResult emit_concat(const std::vector<ExprResult> &parts, int line);
 
     std::pair<TypeKind,int> resolve_type_name(const std::string &s);
     void compile_stmt();
@@ -69,6 +95,8 @@ private:
     int make_string_const(const std::string &s, int line);
     int make_nil_const(int line);
     int emit_call_helper(int line, FunctionSig* fs, const std::vector<int>& arg_regs);
+    void compile_call_args(int line, std::vector<int>& arg_regs, std::vector<TypeKind>& arg_types);
+    ExprResult compile_import_call(const std::string& alias, int line);
     template<typename F>
     void parse_delimited(TK open, TK close, F element_cb);
     bool parse_param_pair(std::string &out_name, TypeKind &out_type);
@@ -0,0 +1,161 @@
+#include "assembler.h"
+#include "profile.h"
+#include <algorithm>
+#include <map>
+
+namespace {
+    // "jmp_false c, E; THEN; jmp X; E: ELSE; X:" becomes "jmp_true c, T; ELSE; jmp X; T: THEN; X:",
+    // the same size, so nothing outside [i, X) moves
+    bool flip_if_else(std::vector<Instr>& code, int i, int body_start, int body_end) {
+        int j = code[i].b;
+        if (j <= i + 1 || j > body_end || code[j - 1].op != OP_JMP) return false;
+        int x = code[j - 1].b;
+        if (x < j || x > body_end) return false;
+        // nothing may jump into the middle of the region, and its own jumps stay inside or go to X
+        for (int pc = body_start; pc < body_end; ++pc) {
+            const Instr& ins = code[pc];
+            if (!op_has_pc_target(ins.op) || op_calls_pc(ins.op)) continue;
+            bool inside = pc >= i && pc < x;
+            if (!inside && ins.b > i && ins.b < x) return false;
+            if (inside && (ins.b < i || ins.b > x)) return false;
+        }
+
+        int else_len = x - j;
+        int then_at = i + 2 + else_len;
+        auto moved = [&](int t) {
+            if (t <= i || t >= x) return t;
+            if (t == j - 1) return x;              // the jump over ELSE is gone, THEN now falls into X
+            if (t < j - 1) return t - (i + 1) + then_at;
+            return t - j + i + 1;
+        };
+
+        std::vector<Instr> region;
+        region.reserve(x - i);
+        Instr head = code[i];
+        head.op = OP_JMP_TRUE;
+        head.b = then_at;
+        region.push_back(head);
+        region.insert(region.end(), code.begin() + j, code.begin() + x);
+        region.push_back(code[j - 1]);
+        region.insert(region.end(), code.begin() + i + 1, code.begin() + j - 1);
+        for (size_t k = 1; k < region.size(); ++k)
+            if (op_has_pc_target(region[k].op) && !op_calls_pc(region[k].op)) region[k].b = moved(region[k].b);
+        std::copy(region.begin(), region.end(), code.begin() + i);
+        return true;
+    }
+
+    int percent(uint64_t part, uint64_t whole) { return whole ? (int)(part * 100 / whole) : 0; }
+}
+
+void Assembler::apply_profile(const Profile& profile) {
+    order_branches_by_profile(profile);
+    order_functions_by_profile(profile);
+}
+
+void Assembler::order_branches_by_profile(const Profile& profile) {
+    std::vector<std::string> keys = function_keys(functions);
+    for (size_t f = 0; f < functions.size(); ++f) {
+        auto it = profile.functions.find(keys[f]);
+        if (it == profile.functions.end()) continue;
+        int start = labels[functions[f].entry_label].target_pc, end = labels[functions[f].end_label].target_pc;
+        if (start < 0 || end <= start) continue;
+
+        std::map<std::pair<int, int>, const BranchProfile*> seen;
+        for (const BranchProfile& b : it->second.branches) seen[{b.line, b.ordinal}] = &b;
+        std::vector<std::pair<int, int>> bkeys = branch_keys(code, start, end);
+
+        // decided on the code as it is, applied innermost (last) first
+        std::vector<std::pair<int, const BranchProfile*>> flips;
+        size_t k = 0;
+        for (int pc = start; pc < end; ++pc) {
+            if (!op_is_cond_jump(code[pc].op)) continue;
+            auto b = seen.find(bkeys[k++]);
+            if (code[pc].op == OP_JMP_FALSE && b != seen.end() && b->second->cond_false > b->second->cond_true)
+                flips.push_back({pc, b->second});
+        }
+        for (auto r = flips.rbegin(); r != flips.rend(); ++r) {
+            const BranchProfile& b = *r->second;
+            if (!flip_if_else(code, r->first, start, end)) continue;
+            remarks.push_back({"pgo", code[r->first].line, "else branch taken " +
+                std::to_string(percent(b.cond_false, b.cond_false + b.cond_true)) + "% of " +
+                std::to_string(b.cond_false + b.cond_true) + " times, laid out first"});
+        }
+    }
+}
+
+void Assembler::order_functions_by_profile(const Profile& profile) {
+    int n = (int)code.size();
+    std::vector<std::string> keys = function_keys(functions);
+    struct Segment { int start, end, func; };
+    std::vector<Segment> bodies;
+    for (size_t f = 0; f < functions.size(); ++f) {
+        int s = labels[functions[f].entry_label].target_pc, e = labels[functions[f].end_label].target_pc;
+        if (s >= 0 && e > s && e <= n) bodies.push_back({s, e, (int)f});
+    }
+    std::sort(bodies.begin(), bodies.end(), [](const Segment& x, const Segment& y) { return x.start < y.start; });
+
+    // entry code lives outside the bodies; it keeps pc 0 and its own order
+    std::vector<Segment> roots;
+    int pc = 0;
+    for (const Segment& b : bodies) {
+        if (b.start < pc) return;
+        if (b.start > pc) roots.push_back({pc, b.start, -1});
+        pc = b.end;
+    }
+    if (pc < n) roots.push_back({pc, n, -1});
+    if (roots.empty() || roots[0].start != 0) return;
+    // segments get reordered, so none may fall through into the next
+    for (const auto* list : {&roots, &bodies})
+        for (const Segment& s : *list)
+            if (code[s.end - 1].op != OP_JMP && code[s.end - 1].op != OP_RETURN) return;
+
+    auto calls = [&](const Segment& s) -> int64_t {
+        auto it = profile.functions.find(keys[s.func]);
+        return it == profile.functions.end() ? -1 : (int64_t)it->second.calls;
+    };
+    std::vector<Segment> hot, unknown, cold;
+    for (const Segment& b : bodies) {
+        int64_t c = calls(b);
+        (c > 0 ? hot : c < 0 ? unknown : cold).push_back(b);
+    }
+    std::stable_sort(hot.begin(), hot.end(), [&](const Segment& x, const Segment& y) { return calls(x) > calls(y); });
+
+    std::vector<Segment> order = {roots[0]};
+    for (const auto* list : {&hot, &unknown, &cold}) order.insert(order.end(), list->begin(), list->end());
+    order.insert(order.end(), roots.begin() + 1, roots.end());
+
+    std::vector<int> new_pos(n + 1);
+    int pos = 0;
+    for (const Segment& s : order)
+        for (int p = s.start; p < s.end; ++p) new_pos[p] = pos++;
+    new_pos[n] = n;
+    bool moved = false;
+    for (int p = 0; p < n && !moved; ++p) moved = new_pos[p] != p;
+    if (!moved) return;
+
+    std::vector<Instr> out;
+    out.reserve(n);
+    for (const Segment& s : order)
+        for (int p = s.start; p < s.end; ++p) {
+            Instr ins = code[p];
+            if (op_has_pc_target(ins.op) && ins.b >= 0 && ins.b <= n) ins.b = new_pos[ins.b];
+            out.push_back(ins);
+        }
+    code.swap(out);
+    for (const Segment& b : bodies) {
+        labels[functions[b.func].entry_label].target_pc = new_pos[b.start];
+        labels[functions[b.func].end_label].target_pc = new_pos[b.start] + (b.end - b.start);
+    }
+    // bodies emptied by eliminate_dead_functions point at the end
+    for (const FuncInfo& f : functions)
+        if (labels[f.entry_label].target_pc == labels[f.end_label].target_pc)
+            labels[f.entry_label].target_pc = labels[f.end_label].target_pc = n;
+
+    std::string msg = "hottest first:";
+    for (size_t h = 0; h < hot.size() && h < 5; ++h) {
+        int64_t c = calls(hot[h]);
+        msg += (h ? ", " : " ") + functions[hot[h].func].name + " (" + std::to_string(c) + (c == 1 ? " call)" : " calls)");
+    }
+    if (!cold.empty()) msg += "; " + std::to_string(cold.size()) + " functions that never ran moved last";
+    remarks.push_back({"pgo", 0, msg});
+}
@@ -0,0 +1,99 @@
+#include "profile.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+void ProfileCounters::reset(size_t code_size) {
+    counts.assign(code_size, 0);
+    cond_false.assign(code_size, 0);
+    cond_true.assign(code_size, 0);
+    calls.assign(code_size, 0);
+    types.assign(code_size, 0);
+}
+
+std::vector<std::string> function_keys(const std::vector<FuncInfo>& functions) {
+    std::map<std::string, int> seen;
+    std::vector<std::string> keys;
+    for (const FuncInfo& f : functions) keys.push_back(f.name + "#" + std::to_string(seen[f.name]++));
+    return keys;
+}
+
+std::vector<std::pair<int, int>> branch_keys(const std::vector<Instr>& code, int start, int end) {
+    std::map<int, int> per_line;
+    std::vector<std::pair<int, int>> keys;
+    for (int pc = start; pc < end; ++pc)
+        if (op_is_cond_jump(code[pc].op)) keys.push_back({code[pc].line, per_line[code[pc].line]++});
+    return keys;
+}
+
+Profile Profile::collect(const Assembler& program, const ProfileCounters& c) {
+    Profile p;
+    std::vector<std::string> keys = function_keys(program.functions);
+    for (size_t f = 0; f < program.functions.size(); ++f) {
+        int start = program.labels[program.functions[f].entry_label].target_pc;
+        int end = program.labels[program.functions[f].end_label].target_pc;
+        if (start < 0 || end <= start || end > (int)c.counts.size()) continue;
+
+        FunctionProfile fp;
+        fp.calls = c.calls[start];
+        std::vector<std::pair<int, int>> bkeys = branch_keys(program.code, start, end);
+        size_t b = 0;
+        for (int pc = start; pc < end; ++pc) {
+            if (c.counts[pc]) fp.counts[pc - start] = c.counts[pc];
+            if (c.types[pc]) fp.operand_types[pc - start] = c.types[pc];
+            if (op_is_cond_jump(program.code[pc].op)) {
+                if (c.counts[pc]) fp.branches.push_back({bkeys[b].first, bkeys[b].second, c.cond_false[pc], c.cond_true[pc]});
+                b++;
+            }
+        }
+        p.functions[keys[f]] = std::move(fp);
+    }
+    return p;
+}
+
+void Profile::save(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("Could not write profile: " + path);
+    out << "mondot-profile 1\n";
+    for (const auto& [key, fp] : functions) {
+        out << "function " << key << " " << fp.calls << "\n";
+        for (const auto& [off, n] : fp.counts) out << "count " << off << " " << n << "\n";
+        for (const BranchProfile& b : fp.branches)
+            out << "branch " << b.line << " " << b.ordinal << " " << b.cond_false << " " << b.cond_true << "\n";
+        for (const auto& [off, mask] : fp.operand_types) out << "types " << off << " " << mask << "\n";
+    }
+}
+
+Profile Profile::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) throw std::runtime_error("Profile not found: " + path);
+    std::string header;
+    std::getline(in, header);
+    if (header != "mondot-profile 1") throw std::runtime_error("Not a mondot profile: " + path);
+
+    Profile p;
+    FunctionProfile* fp = nullptr;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::string kind;
+        ls >> kind;
+        if (kind == "function") {
+            std::string key;
+            ls >> key;
+            fp = &p.functions[key];
+            ls >> fp->calls;
+        } else if (fp && kind == "count") {
+            int off; uint64_t n;
+            if (ls >> off >> n) fp->counts[off] = n;
+        } else if (fp && kind == "branch") {
+            BranchProfile b;
+            if (ls >> b.line >> b.ordinal >> b.cond_false >> b.cond_true) fp->branches.push_back(b);
+        } else if (fp && kind == "types") {
+            int off; uint32_t mask;
+            if (ls >> off >> mask) fp->operand_types[off] = mask;
+        } else if (!kind.empty())
+            throw std::runtime_error("Malformed profile line: " + line);
+    }
+    return p;
+}
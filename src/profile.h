@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "assembler.h"
+#include "value.h"
+
+// what the VM counts while profiling (--profile-out), indexed by pc
+struct ProfileCounters {
+    std::vector<uint64_t> counts;                   // executions
+    std::vector<uint64_t> cond_false, cond_true;    // conditional jumps: OP_JMP_FALSE taken / not taken
+    std::vector<uint64_t> calls;                    // calls landing on each pc
+    std::vector<uint32_t> types;                    // OP_INDEX / OP_CALL_OBJ operands, see observed_type_bit
+
+    void reset(size_t code_size);
+};
+
+// one bit per TypeKind, nil counted as TY_VOID; OP_INDEX keeps the key's bits from bit 16 up
+inline uint32_t observed_type_bit(const Value& v) {
+    return 1u << (v.is_nil() ? TY_VOID : type_of_value(v));
+}
+
+// a conditional jump, found again by its source line and its order among that line's jumps
+struct BranchProfile {
+    int line;
+    int ordinal;
+    uint64_t cond_false;
+    uint64_t cond_true;
+};
+
+struct FunctionProfile {
+    uint64_t calls = 0;
+    std::map<int, uint64_t> counts;          // offset from the entry -> executions
+    std::vector<BranchProfile> branches;
+    std::map<int, uint32_t> operand_types;   // offset from the entry -> observed types
+};
+
+// a run of a linked program, keyed by function so a later build of the same source can use it
+// even where its code differs (e.g. because the profile changed what got inlined)
+struct Profile {
+    std::map<std::string, FunctionProfile> functions;   // see function_keys
+
+    static Profile collect(const Assembler& program, const ProfileCounters& counters);
+    void save(const std::string& path) const;
+    static Profile load(const std::string& path);
+};
+
+// "name#k" for the k-th function called name, in definition order
+std::vector<std::string> function_keys(const std::vector<FuncInfo>& functions);
+
+// line and per-line ordinal of every conditional jump in [start, end), in code order
+std::vector<std::pair<int, int>> branch_keys(const std::vector<Instr>& code, int start, int end);
@@ -0,0 +1,31 @@
+#include "assembler.h"
+#include "dataflow.h"
+
+// moves out of registers that die right there transfer their reference instead of
+// retaining a copy, and copies between scalar registers skip refcounting altogether
+void Assembler::pass_elide_refcounts() {
+    ControlFlow cfg; cfg.build(*this);
+    Liveness live; live.compute(code, cfg);
+    RegKinds kinds; kinds.compute(code, constants, cfg, live.nregs);
+
+    std::vector<RegSet> after;
+    for (int b = 0; b < (int)cfg.start.size(); ++b) {
+        int s = cfg.start[b];
+        live.live_after(code, cfg, b, after);
+        std::vector<int> st = kinds.in[b];
+        for (int pc = s; pc < cfg.end(b); ++pc) {
+            const Instr orig = code[pc];
+            Instr& ins = code[pc];
+            const RegSet& live_out = after[pc - s];
+            if (ins.op == OP_MOVE && ins.a != ins.b) {
+                if (kind_is_scalar(st[ins.a]) && kind_is_scalar(st[ins.b])) ins.op = OP_MOVE_S;
+                else if (!live_out.test(ins.b)) ins.op = OP_MOVE_OWN;
+            } else if (ins.op == OP_CALL && ins.c > 0) {
+                bool dead = true;
+                for (int i = 1; i <= ins.c && dead; ++i) dead = !live_out.test(ins.a + i);
+                if (dead) ins.op = OP_CALL_OWN;
+            }
+            RegKinds::step(orig, constants, st);
+        }
+    }
+}
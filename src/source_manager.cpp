@@ -1,21 +1,80 @@
 #include "source_manager.h"
-#include <sstream>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-SourceManager::SourceManager(const std::string& src, const std::string& p) : source(src), path(p) {
-    std::stringstream ss(source);
-    std::string line;
-    while (std::getline(ss, line)) lines.push_back(line);
+std::shared_ptr<const SourceBuffer> SourceBuffer::map_file(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("File not found: " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        throw std::runtime_error("File not found: " + path);
+    }
+
+    std::shared_ptr<SourceBuffer> buf(new SourceBuffer());
+    if (st.st_size > 0) {
+        void* p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            buf->data_ = static_cast<const char*>(p);
+            buf->size_ = (size_t)st.st_size;
+            buf->mapped_ = true;
+        } else {
+            // some filesystems cannot be mapped; fall back to one read
+            buf->owned_.resize((size_t)st.st_size);
+            ssize_t got = ::pread(fd, buf->owned_.data(), buf->owned_.size(), 0);
+            buf->owned_.resize(got > 0 ? (size_t)got : 0);
+            buf->data_ = buf->owned_.data();
+            buf->size_ = buf->owned_.size();
+        }
+    }
+    ::close(fd);
+    return buf;
+}
+
+std::shared_ptr<const SourceBuffer> SourceBuffer::from_string(std::string text) {
+    std::shared_ptr<SourceBuffer> buf(new SourceBuffer());
+    buf->owned_ = std::move(text);
+    buf->data_ = buf->owned_.data();
+    buf->size_ = buf->owned_.size();
+    return buf;
+}
+
+SourceBuffer::~SourceBuffer() {
+    if (mapped_) ::munmap(const_cast<char*>(data_), size_);
+}
+
+SourceManager::SourceManager(std::string_view src, const std::string& p) : source(src), path(p) {}
+
+bool SourceManager::line_text(int line, std::string_view& out) {
+    if (!indexed_) {
+        if (!source.empty()) line_starts_.push_back(0);
+        const char* begin = source.data();
+        const char* end = begin + source.size();
+        for (const char* p = begin; (p = static_cast<const char*>(std::memchr(p, '\n', end - p))) && ++p < end;)
+            line_starts_.push_back(p - begin);
+        indexed_ = true;
+    }
+    if (line <= 0 || line > (int)line_starts_.size()) return false;
+    size_t start = line_starts_[line - 1];
+    size_t stop = line < (int)line_starts_.size() ? line_starts_[line] : source.size();
+    if (stop > start && source[stop - 1] == '\n') stop--;
+    out = source.substr(start, stop - start);
+    return true;
 }
 
 void SourceManager::report(const std::string& title, SourceLocation loc, const std::string& msg) {
     std::cerr << "\n\033[1;31m" << title << ":\033[0m " << msg << "\n";
     if (!path.empty()) std::cerr << "    at " << path << "\n";
-    if (loc.line > 0 && loc.line <= (int)lines.size()) {
-        std::string code_line = lines[loc.line - 1];
-        std::string print_line = code_line;
+    std::string_view code_line;
+    if (line_text(loc.line, code_line)) {
+        std::string print_line(code_line);
         std::replace(print_line.begin(), print_line.end(), '\t', ' ');
         std::cerr << "    |\n" << std::setw(3) << loc.line << " | " << print_line << "\n    | ";
         for (int i = 1; i < loc.col; i++) std::cerr << " ";
@@ -1,14 +1,45 @@
 #pragma once
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct SourceLocation { int line; int col; int length; };
 
+// read-only source text, mapped from its file when possible. Compilers, parsers and
+// tokens all view the same bytes, so keep the buffer alive while any of them is in use.
+class SourceBuffer {
+public:
+    static std::shared_ptr<const SourceBuffer> map_file(const std::string& path);
+    static std::shared_ptr<const SourceBuffer> from_string(std::string text);
+    ~SourceBuffer();
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    std::string_view text() const { return {data_, size_}; }
+    // text() is a page-aligned file mapping rather than a copy
+    bool mapped() const { return mapped_; }
+
+private:
+    SourceBuffer() = default;
+    const char* data_ = "";
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::string owned_;
+};
+
+// does not own the text; line offsets are only computed once a report needs them
 struct SourceManager {
-    std::string source;
-    std::vector<std::string> lines;
+    std::string_view source;
     std::string path;
 
-    SourceManager(const std::string& src = "", const std::string& p = "");
+    SourceManager(std::string_view src = "", const std::string& p = "");
     void report(const std::string& title, SourceLocation loc, const std::string& msg);
+
+private:
+    std::vector<size_t> line_starts_;
+    bool indexed_ = false;
+
+    bool line_text(int line, std::string_view& out);
 };
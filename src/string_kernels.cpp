@@ -0,0 +1,125 @@
+#include "string_kernels.h"
+#include <cstring>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+    constexpr size_t NPOS = std::string_view::npos;
+
+    // positions are first filtered on the needle's first and last byte, the rest checked here
+    inline bool middle_matches(const char* at, const char* needle, size_t m) {
+        return m <= 2 || std::memcmp(at + 1, needle + 1, m - 2) == 0;
+    }
+
+    size_t find_scalar(const char* s, size_t n, const char* needle, size_t m, size_t i) {
+        for (; i + m <= n; ++i)
+            if (s[i] == needle[0] && s[i + m - 1] == needle[m - 1] && middle_matches(s + i, needle, m)) return i;
+        return NPOS;
+    }
+
+#if defined(__x86_64__)
+    size_t find_sse2(const char* s, size_t n, const char* needle, size_t m, size_t i) {
+        const __m128i first = _mm_set1_epi8(needle[0]), last = _mm_set1_epi8(needle[m - 1]);
+        for (; i + m - 1 + 16 <= n; i += 16) {
+            __m128i f = _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i*)(s + i)));
+            __m128i l = _mm_cmpeq_epi8(last, _mm_loadu_si128((const __m128i*)(s + i + m - 1)));
+            for (unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(f, l)); mask; mask &= mask - 1) {
+                size_t at = i + __builtin_ctz(mask);
+                if (middle_matches(s + at, needle, m)) return at;
+            }
+        }
+        return find_scalar(s, n, needle, m, i);
+    }
+
+    __attribute__((target("avx2")))
+    size_t find_avx2(const char* s, size_t n, const char* needle, size_t m, size_t i) {
+        const __m256i first = _mm256_set1_epi8(needle[0]), last = _mm256_set1_epi8(needle[m - 1]);
+        for (; i + m - 1 + 32 <= n; i += 32) {
+            __m256i f = _mm256_cmpeq_epi8(first, _mm256_loadu_si256((const __m256i*)(s + i)));
+            __m256i l = _mm256_cmpeq_epi8(last, _mm256_loadu_si256((const __m256i*)(s + i + m - 1)));
+            for (unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(f, l)); mask; mask &= mask - 1) {
+                size_t at = i + __builtin_ctz(mask);
+                if (middle_matches(s + at, needle, m)) return at;
+            }
+        }
+        return find_sse2(s, n, needle, m, i);
+    }
+
+    size_t either_sse2(const char* s, size_t n, char a, char b, size_t i) {
+        const __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b);
+        for (; i + 16 <= n; i += 16) {
+            __m128i x = _mm_loadu_si128((const __m128i*)(s + i));
+            unsigned mask = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)));
+            if (mask) return i + __builtin_ctz(mask);
+        }
+        for (; i < n; ++i)
+            if (s[i] == a || s[i] == b) return i;
+        return NPOS;
+    }
+
+    __attribute__((target("avx2")))
+    size_t either_avx2(const char* s, size_t n, char a, char b, size_t i) {
+        const __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b);
+        for (; i + 32 <= n; i += 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(s + i));
+            unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, va), _mm256_cmpeq_epi8(x, vb)));
+            if (mask) return i + __builtin_ctz(mask);
+        }
+        return either_sse2(s, n, a, b, i);
+    }
+#else
+    size_t either_scalar(const char* s, size_t n, char a, char b, size_t i) {
+        for (; i < n; ++i)
+            if (s[i] == a || s[i] == b) return i;
+        return NPOS;
+    }
+#endif
+
+    using FindKernel = size_t (*)(const char*, size_t, const char*, size_t, size_t);
+
+    FindKernel pick_find_kernel() {
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return find_avx2;
+        return find_sse2;
+#else
+        return find_scalar;
+#endif
+    }
+
+    const FindKernel find_kernel = pick_find_kernel();
+
+    using EitherKernel = size_t (*)(const char*, size_t, char, char, size_t);
+
+    EitherKernel pick_either_kernel() {
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return either_avx2;
+        return either_sse2;
+#else
+        return either_scalar;
+#endif
+    }
+
+    const EitherKernel either_kernel = pick_either_kernel();
+}
+
+size_t string_find(std::string_view s, std::string_view needle, size_t from) {
+    if (from > s.size()) return NPOS;
+    if (needle.empty()) return from;
+    if (needle.size() > s.size() - from) return NPOS;
+    return find_kernel(s.data(), s.size(), needle.data(), needle.size(), from);
+}
+
+size_t string_count(std::string_view s, std::string_view needle) {
+    if (needle.empty()) return 0;
+    size_t n = 0;
+    for (size_t at = string_find(s, needle); at != NPOS; at = string_find(s, needle, at + needle.size())) ++n;
+    return n;
+}
+
+size_t string_find_either(std::string_view s, char a, char b, size_t from) {
+    if (from >= s.size()) return NPOS;
+    return either_kernel(s.data(), s.size(), a, b, from);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+// byte search behind the string builtins: 32 or 16 positions per step with AVX2 or SSE2,
+// picked once from what the CPU supports, plain loops elsewhere
+
+// first occurrence of needle in s at or after from, std::string_view::npos when none;
+// an empty needle matches at from
+size_t string_find(std::string_view s, std::string_view needle, size_t from = 0);
+
+// non-overlapping occurrences of needle in s, 0 for an empty needle
+size_t string_count(std::string_view s, std::string_view needle);
+
+// first position at or after from holding a or b, std::string_view::npos when none
+size_t string_find_either(std::string_view s, char a, char b, size_t from = 0);
@@ -0,0 +1,63 @@
+#include "symbol_table.h"
+#include <algorithm>
+
+int LocalTable::define(const std::string& name, int depth, TypeKind t, int user_type_id) {
+    int slot = (int)entries_.size();
+    entries_.push_back({name, depth, slot, t, user_type_id});
+    if (!name.empty()) visible_[name].push_back(slot);
+    return slot;
+}
+
+int LocalTable::resolve(const std::string& name) const {
+    auto it = visible_.find(name);
+    if (it == visible_.end() || it->second.empty()) return -1;
+    return it->second.back();
+}
+
+void LocalTable::pop_scope(int depth) {
+    while (!entries_.empty() && entries_.back().depth > depth) {
+        const std::string& name = entries_.back().name;
+        if (!name.empty()) visible_[name].pop_back();
+        entries_.pop_back();
+    }
+}
+
+void LocalTable::clear() {
+    entries_.clear();
+    visible_.clear();
+}
+
+void FunctionTable::add(const FunctionSig& fs) {
+    Overloads& o = names_[fs.name];
+    o.by_arity[fs.param_types.size()].push_back((int)o.sigs.size());
+    o.sigs.push_back(fs);
+}
+
+Overloads* FunctionTable::find(const std::string& name) {
+    auto it = names_.find(name);
+    return it == names_.end() ? nullptr : &it->second;
+}
+
+const Overloads* FunctionTable::find(const std::string& name) const {
+    auto it = names_.find(name);
+    return it == names_.end() ? nullptr : &it->second;
+}
+
+FunctionSig* FunctionTable::find_label(const std::string& name, int label_id) {
+    Overloads* o = find(name);
+    if (!o) return nullptr;
+    for (FunctionSig& fs : o->sigs) if (fs.label_id == label_id) return &fs;
+    return nullptr;
+}
+
+void FunctionTable::set_params(FunctionSig& fs, const std::vector<TypeKind>& params) {
+    Overloads& o = names_.at(fs.name);
+    int index = (int)(&fs - o.sigs.data());
+    if (params.size() != fs.param_types.size()) {
+        auto& from = o.by_arity[fs.param_types.size()];
+        from.erase(std::find(from.begin(), from.end(), index));
+        auto& to = o.by_arity[params.size()];
+        to.insert(std::lower_bound(to.begin(), to.end(), index), index);
+    }
+    fs.param_types = params;
+}
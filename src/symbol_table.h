@@ -0,0 +1,57 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "value.h"
+
+struct FunctionSig {
+    std::string name;
+    std::string internal_name;
+    std::vector<TypeKind> param_types;
+    TypeKind return_type = TY_VOID;
+    int user_return_type_id = -1;
+    int label_id = -1;
+    int declared_line = 0;
+    bool is_builtin = false;
+    bool memo = false;   // declared "memo on ...", called through OP_CALL_MEMO
+};
+
+struct LocalEntry { std::string name; int depth; int slot; TypeKind type; int user_type_id; };
+
+// locals of the function being compiled, indexed by slot. Names map to the slots that
+// currently carry them, innermost last, so lookups do not scan temporaries.
+class LocalTable {
+public:
+    int define(const std::string& name, int depth, TypeKind t, int user_type_id);
+    int resolve(const std::string& name) const;   // -1 when not in scope
+    void pop_scope(int depth);                    // drops every local deeper than depth
+    void clear();
+
+    LocalEntry& operator[](int slot) { return entries_[slot]; }
+    const LocalEntry& operator[](int slot) const { return entries_[slot]; }
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+
+private:
+    std::vector<LocalEntry> entries_;
+    std::unordered_map<std::string, std::vector<int>> visible_;
+};
+
+// every overload of a name in declaration order, with the overloads of each arity
+struct Overloads {
+    std::vector<FunctionSig> sigs;
+    std::unordered_map<size_t, std::vector<int>> by_arity;   // indices into sigs, ascending
+};
+
+class FunctionTable {
+public:
+    void add(const FunctionSig& fs);
+    Overloads* find(const std::string& name);
+    const Overloads* find(const std::string& name) const;
+    FunctionSig* find_label(const std::string& name, int label_id);
+    // signatures are declared before their parameters are parsed; this keeps by_arity current
+    void set_params(FunctionSig& fs, const std::vector<TypeKind>& params);
+
+private:
+    std::unordered_map<std::string, Overloads> names_;
+};
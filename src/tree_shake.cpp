@@ -0,0 +1,61 @@
+#include "assembler.h"
+#include <algorithm>
+
+// code outside every function body (the entry stub and the call to main) is live; a
+// function is live once a live instruction calls it. OP_CALL_OBJ only ever calls natives.
+int Assembler::eliminate_dead_functions() {
+    struct Body { int start, end, func; };
+    std::vector<Body> bodies;
+    int n = (int)code.size();
+    std::vector<int> owner(n, -1);   // body holding each pc
+    for (size_t f = 0; f < functions.size(); ++f) {
+        int s = labels[functions[f].entry_label].target_pc, e = std::min(labels[functions[f].end_label].target_pc, n);
+        if (s < 0 || e <= s) continue;
+        std::fill(owner.begin() + s, owner.begin() + e, (int)bodies.size());
+        bodies.push_back({s, e, (int)f});
+    }
+
+    std::vector<char> live_body(bodies.size(), 0);
+    std::vector<int> work;
+    auto visit = [&](int pc) {
+        const Instr& ins = code[pc];
+        if (!op_has_pc_target(ins.op) || ins.b < 0 || ins.b >= n) return;
+        int b = owner[ins.b];
+        if (b >= 0 && !live_body[b]) { live_body[b] = 1; work.push_back(b); }
+    };
+
+    bool has_roots = false;
+    for (int pc = 0; pc < n; ++pc)
+        if (owner[pc] < 0) { has_roots = true; visit(pc); }
+    // a library on its own: every export may be called
+    if (!has_roots) return 0;
+    while (!work.empty()) {
+        const Body& body = bodies[work.back()];
+        work.pop_back();
+        for (int pc = body.start; pc < body.end; ++pc) visit(pc);
+    }
+
+    std::vector<char> removed(n, 0);
+    int dropped = 0;
+    for (size_t b = 0; b < bodies.size(); ++b) {
+        if (live_body[b]) continue;
+        const Body& body = bodies[b];
+        std::fill(removed.begin() + body.start, removed.begin() + body.end, 1);
+        dropped++;
+        int line = body.end > body.start ? code[body.start].line : 0;
+        remarks.push_back({"dead-functions", line, "removed unreachable function '" + functions[body.func].name + "'"});
+    }
+    if (!dropped) return 0;
+    // the FuncInfo entries stay, with empty bodies, so function_keys() does not shift
+    splice_code(removed, {});
+
+    // constants only the dropped bodies loaded
+    std::vector<int> const_map(constants.size(), -1);
+    for (const Instr& ins : code) if (ins.op == OP_CONST) const_map[ins.b] = 0;
+    std::vector<Value> used;
+    for (size_t k = 0; k < constants.size(); ++k)
+        if (const_map[k] == 0) { const_map[k] = (int)used.size(); used.push_back(constants[k]); }
+    constants.swap(used);
+    for (Instr& ins : code) if (ins.op == OP_CONST) ins.b = const_map[ins.b];
+    return dropped;
+}
@@ -0,0 +1,44 @@
+#include "assembler.h"
+#include "dataflow.h"
+
+// rewrites generic opcodes whose operands are proven by a forward kind analysis
+bool Assembler::pass_specialize_types() {
+    ControlFlow cfg; cfg.build(*this);
+    int nregs = max_register(code, 0, (int)code.size()) + 1;
+    int nb = (int)cfg.start.size();
+
+    RegKinds kinds; kinds.compute(code, constants, cfg, nregs);
+
+    bool rewritten = false;
+    for (int b = 0; b < nb; ++b) {
+        std::vector<int> st = kinds.in[b];
+        for (int pc = cfg.start[b]; pc < cfg.end(b); ++pc) {
+            Instr& ins = code[pc];
+            auto kind = [&](int r) { return (r >= 0 && r < nregs) ? st[r] : KIND_UNKNOWN; };
+            switch (ins.op) {
+                case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_LT: case OP_GT:
+                    if (kind(ins.b) == KIND_NUMBER && kind(ins.c) == KIND_NUMBER) {
+                        ins.op = typed_number_op(ins.op);
+                        rewritten = true;
+                    }
+                    break;
+                case OP_LIST_GET:
+                    if (kind(ins.b) == KIND_LIST && kind(ins.c) == KIND_NUMBER) {
+                        ins.op = OP_LIST_GET_L;
+                        rewritten = true;
+                    }
+                    break;
+                case OP_STRUCT_GET:
+                    if (kind_is_item(kind(ins.b)) && ins.c >= 0 && ins.c < kind(ins.b) - KIND_ITEM) {
+                        ins.op = OP_FIELD_GET_ITEM;
+                        rewritten = true;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            RegKinds::step(ins, constants, st);
+        }
+    }
+    return rewritten;
+}
@@ -1,5 +1,7 @@
 #pragma once
+#include <memory>
 #include <string>
+#include <string_view>
 #include <cstdint>
 #include <vector>
 #include <utility>
@@ -12,6 +14,12 @@ enum Tag : uint8_t { TAG_NIL=0, TAG_BOOL=1, TAG_NUM=2, TAG_OBJ=3 };
 static constexpr int INTSCALED_SHIFT = 32;
 static constexpr uint64_t INTSCALED_ONE = (1ULL << INTSCALED_SHIFT);
 
+__extension__ typedef __int128 wide_int;
+
+// 32.32 fixed-point arithmetic shared by the VM and the compile-time folders
+inline int64_t intscaled_mul(int64_t a, int64_t b) { return (int64_t)(((wide_int)a * (wide_int)b) >> INTSCALED_SHIFT); }
+inline int64_t intscaled_div(int64_t a, int64_t b) { return (int64_t)(((wide_int)a << INTSCALED_SHIFT) / (wide_int)b); }
+
 struct Obj;
 struct ObjString;
 struct ObjList;
@@ -19,15 +27,16 @@ struct ObjTable;
 struct ObjFunction;
 struct ObjStruct;
 
-enum TypeKind { TY_UNKNOWN=0, TY_VOID=1, TY_NUMBER=2, TY_STRING=3, TY_BOOL=4, TY_LIST=5, TY_TABLE=6, TY_ITEM=7 };
+enum TypeKind { TY_UNKNOWN=0, TY_VOID=1, TY_NUMBER=2, TY_STRING=3, TY_BOOL=4, TY_LIST=5, TY_TABLE=6, TY_ITEM=7, TY_FILE=8 };
 
-inline TypeKind parse_type_name(const std::string& s) {
+inline TypeKind parse_type_name(std::string_view s) {
     if (s == "void") return TY_VOID;
     if (s == "number") return TY_NUMBER;
     if (s == "string") return TY_STRING;
     if (s == "bool") return TY_BOOL;
     if (s == "list") return TY_LIST;
     if (s == "table") return TY_TABLE;
+    if (s == "file") return TY_FILE;
     return TY_UNKNOWN;
 }
 
@@ -68,7 +77,7 @@ struct Value {
     }
 };
 
-enum ObjType { OBJ_STRING=1, OBJ_LIST=2, OBJ_TABLE=3, OBJ_FUNCTION=4, OBJ_STRUCT=5 };
+enum ObjType { OBJ_STRING=1, OBJ_LIST=2, OBJ_TABLE=3, OBJ_FUNCTION=4, OBJ_STRUCT=5, OBJ_FILE=6 };
 
 struct Obj {
     int type;
@@ -76,23 +85,49 @@ struct Obj {
     Obj(int t): type(t), refcount(1) {}
     virtual ~Obj() {}
 };
+// owns its characters in str, or views length characters at chars that belong to someone
+// else: a slice's parent, which it keeps alive and which never changes while referenced, or
+// the owner of an ObjExternalString. Read the characters through view(); only strings that
+// own them can grow.
 struct ObjString : Obj {
     std::string str;
+    ObjString* parent = nullptr;
+    const char* chars = nullptr;
+    size_t length = 0;
+
     ObjString(std::string s): Obj(OBJ_STRING), str(std::move(s)) {}
+    ObjString(ObjString* p, size_t off, size_t len);
+    ~ObjString();
+
+    bool owns_chars() const { return chars == nullptr; }
+    std::string_view view() const { return chars ? std::string_view(chars, length) : std::string_view(str); }
+
+protected:
+    explicit ObjString(std::string_view external) : Obj(OBJ_STRING), chars(external.data()), length(external.size()) {}
+};
+
+// characters kept alive by owner, e.g. a mapped file
+struct ObjExternalString : ObjString {
+    std::shared_ptr<const void> owner;
+    ObjExternalString(std::string_view external, std::shared_ptr<const void> o) : ObjString(external), owner(std::move(o)) {}
 };
+// containers hold a reference to each element and drop them when they go
 struct ObjList : Obj {
     std::vector<Value> elements;
     ObjList(): Obj(OBJ_LIST) {}
+    ~ObjList();
 };
 struct ObjTable : Obj {
     std::vector<std::pair<Value, Value>> entries;
     ObjTable(): Obj(OBJ_TABLE) {}
+    ~ObjTable();
 };
 
 struct ObjStruct : Obj {
     int item_type_id;
     std::vector<Value> fields;
     ObjStruct(int item_id = -1) : Obj(OBJ_STRUCT), item_type_id(item_id) {}
+    ~ObjStruct();
 };
 
 struct ObjFunction : Obj {
@@ -125,6 +160,24 @@ inline void release(Value v) {
     }
 }
 
+// slices of slices point at the string holding the characters
+inline ObjString::ObjString(ObjString* p, size_t off, size_t len)
+    : Obj(OBJ_STRING), parent(p->parent ? p->parent : p), chars(p->view().data() + off), length(len) {
+    ++parent->refcount;
+}
+inline ObjString::~ObjString() {
+    if (parent) release(Value::make_obj(parent));
+}
+inline ObjList::~ObjList() {
+    for (Value v : elements) release(v);
+}
+inline ObjTable::~ObjTable() {
+    for (auto& [k, v] : entries) { release(k); release(v); }
+}
+inline ObjStruct::~ObjStruct() {
+    for (Value v : fields) release(v);
+}
+
 inline TypeKind type_of_value(const Value& v) {
     if (v.is_num()) return TY_NUMBER;
     if (v.is_bool()) return TY_BOOL;
@@ -134,6 +187,7 @@ inline TypeKind type_of_value(const Value& v) {
         if (o->type == OBJ_STRING) return TY_STRING;
         if (o->type == OBJ_LIST) return TY_LIST;
         if (o->type == OBJ_TABLE) return TY_TABLE;
+        if (o->type == OBJ_FILE) return TY_FILE;
         if (o->type == OBJ_STRUCT) return TY_ITEM;
     }
     return TY_UNKNOWN;
@@ -153,7 +207,7 @@ inline bool value_equal(const Value& a, const Value& b) {
         if (!oa || !ob) return false;
         if (oa->type != ob->type) return false;
         if (oa->type == OBJ_STRING) {
-            return ((ObjString*)oa)->str == ((ObjString*)ob)->str;
+            return ((ObjString*)oa)->view() == ((ObjString*)ob)->view();
         }
         // design choice
         return oa == ob;
@@ -0,0 +1,119 @@
+#include "vec_kernels.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+    template<VecOp OP>
+    inline Value apply(Value x, Value y) {
+        if (!x.is_num() || !y.is_num()) return Value::make_nil();
+        int64_t p = x.as_intscaled(), q = y.as_intscaled();
+        switch (OP) {
+            case VEC_ADD: return Value::make_intscaled(p + q);
+            case VEC_SUB: return Value::make_intscaled(p - q);
+            case VEC_MUL: return Value::make_intscaled(intscaled_mul(p, q));
+            case VEC_DIV: return q == 0 ? Value::make_nil() : Value::make_intscaled(intscaled_div(p, q));
+            case VEC_MIN: return q < p ? y : x;
+            case VEC_MAX: return q > p ? y : x;
+        }
+        return Value::make_nil();
+    }
+
+    template<VecOp OP, bool SA, bool SB>
+    void arith_scalar(const Value* a, const Value* b, Value* out, size_t i, size_t n, bool out_owns) {
+        for (; i < n; ++i) {
+            Value r = apply<OP>(a[SA ? 0 : i], b[SB ? 0 : i]);
+            Value old = out[i];
+            out[i] = r;
+            if (out_owns) release(old);
+        }
+    }
+
+#if defined(__x86_64__)
+    // x >> 3 keeping the sign, which AVX2 has no 64-bit instruction for
+    __attribute__((target("avx2")))
+    inline __m256i sra3(__m256i x) {
+        __m256i sign = _mm256_cmpgt_epi64(_mm256_setzero_si256(), x);
+        return _mm256_or_si256(_mm256_srli_epi64(x, 3), _mm256_slli_epi64(sign, 61));
+    }
+
+    // intscaled_mul per lane without 128-bit products: bits 32..95 of the unsigned product
+    // from four 32x32 multiplies, then the two-complement correction for negative inputs
+    __attribute__((target("avx2")))
+    inline __m256i mul_fixed(__m256i qa, __m256i qb) {
+        __m256i ah = _mm256_srli_epi64(qa, 32), bh = _mm256_srli_epi64(qb, 32);
+        __m256i r = _mm256_slli_epi64(_mm256_mul_epu32(ah, bh), 32);
+        r = _mm256_add_epi64(r, _mm256_mul_epu32(ah, qb));
+        r = _mm256_add_epi64(r, _mm256_mul_epu32(qa, bh));
+        r = _mm256_add_epi64(r, _mm256_srli_epi64(_mm256_mul_epu32(qa, qb), 32));
+        __m256i zero = _mm256_setzero_si256();
+        __m256i corr = _mm256_add_epi64(_mm256_and_si256(_mm256_cmpgt_epi64(zero, qa), qb),
+                                        _mm256_and_si256(_mm256_cmpgt_epi64(zero, qb), qa));
+        return _mm256_sub_epi64(r, _mm256_slli_epi64(corr, 32));
+    }
+
+    template<VecOp OP, bool SA, bool SB>
+    __attribute__((target("avx2")))
+    void arith_avx2(const Value* a, const Value* b, Value* out, size_t n, bool out_owns) {
+        const __m256i tag_mask = _mm256_set1_epi64x(7), num_tag = _mm256_set1_epi64x(TAG_NUM);
+        const __m256i sa = _mm256_set1_epi64x((long long)a[0].raw), sb = _mm256_set1_epi64x((long long)b[0].raw);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256i va = SA ? sa : _mm256_loadu_si256((const __m256i*)(a + i));
+            __m256i vb = SB ? sb : _mm256_loadu_si256((const __m256i*)(b + i));
+            __m256i nums = _mm256_and_si256(_mm256_cmpeq_epi64(_mm256_and_si256(va, tag_mask), num_tag),
+                                            _mm256_cmpeq_epi64(_mm256_and_si256(vb, tag_mask), num_tag));
+            if (_mm256_movemask_epi8(nums) != -1) {
+                arith_scalar<OP, SA, SB>(a, b, out, i, i + 4, out_owns);
+                continue;
+            }
+            __m256i r;
+            if constexpr (OP == VEC_ADD) r = _mm256_sub_epi64(_mm256_add_epi64(va, vb), num_tag);
+            else if constexpr (OP == VEC_SUB) r = _mm256_add_epi64(_mm256_sub_epi64(va, vb), num_tag);
+            // tagged numbers order like the numbers themselves
+            else if constexpr (OP == VEC_MIN) r = _mm256_blendv_epi8(va, vb, _mm256_cmpgt_epi64(va, vb));
+            else if constexpr (OP == VEC_MAX) r = _mm256_blendv_epi8(va, vb, _mm256_cmpgt_epi64(vb, va));
+            else r = _mm256_or_si256(_mm256_slli_epi64(mul_fixed(sra3(va), sra3(vb)), 3), num_tag);
+            _mm256_storeu_si256((__m256i*)(out + i), r);
+        }
+        arith_scalar<OP, SA, SB>(a, b, out, i, n, out_owns);
+    }
+
+    bool pick_avx2() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+
+    const bool use_avx2 = pick_avx2();
+#endif
+
+    template<VecOp OP, bool SA, bool SB>
+    void arith(const Value* a, const Value* b, Value* out, size_t n, bool out_owns) {
+#if defined(__x86_64__)
+        if constexpr (OP != VEC_DIV) {
+            if (use_avx2) { arith_avx2<OP, SA, SB>(a, b, out, n, out_owns); return; }
+        }
+#endif
+        arith_scalar<OP, SA, SB>(a, b, out, 0, n, out_owns);
+    }
+
+    template<VecOp OP>
+    void arith_shapes(const Value* a, bool a_scalar, const Value* b, bool b_scalar, Value* out, size_t n, bool out_owns) {
+        if (a_scalar) arith<OP, true, false>(a, b, out, n, out_owns);
+        else if (b_scalar) arith<OP, false, true>(a, b, out, n, out_owns);
+        else arith<OP, false, false>(a, b, out, n, out_owns);
+    }
+}
+
+void vec_arith(VecOp op, const Value* a, bool a_scalar, const Value* b, bool b_scalar, Value* out, size_t n,
+               bool out_owns) {
+    if (n == 0) return;
+    switch (op) {
+        case VEC_ADD: arith_shapes<VEC_ADD>(a, a_scalar, b, b_scalar, out, n, out_owns); break;
+        case VEC_SUB: arith_shapes<VEC_SUB>(a, a_scalar, b, b_scalar, out, n, out_owns); break;
+        case VEC_MUL: arith_shapes<VEC_MUL>(a, a_scalar, b, b_scalar, out, n, out_owns); break;
+        case VEC_DIV: arith_shapes<VEC_DIV>(a, a_scalar, b, b_scalar, out, n, out_owns); break;
+        case VEC_MIN: arith_shapes<VEC_MIN>(a, a_scalar, b, b_scalar, out, n, out_owns); break;
+        case VEC_MAX: arith_shapes<VEC_MAX>(a, a_scalar, b, b_scalar, out, n, out_owns); break;
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "value.h"
+#include <cstddef>
+
+// element-wise arithmetic behind list + - * / and the list forms of min and max, on numbers
+// as the VM stores them: four per step with AVX2, picked once from what the CPU supports,
+// plain loops elsewhere. Division has no vector form and always runs the plain loop.
+
+// the first four in the order of OP_VEC_ADD .. OP_VEC_DIV
+enum VecOp { VEC_ADD, VEC_SUB, VEC_MUL, VEC_DIV, VEC_MIN, VEC_MAX };
+
+// out[i] = a[i] op b[i] for i < n, where a scalar side repeats its one value. Pairs that are
+// not both numbers, and division by 0, give nil like the scalar opcodes. out may be a or b;
+// with out_owns the values it replaces are released.
+void vec_arith(VecOp op, const Value* a, bool a_scalar, const Value* b, bool b_scalar, Value* out, size_t n,
+               bool out_owns);
@@ -1,9 +1,12 @@
 #include "vm.h"
 #include <cmath>
 #include "builtin_registry.h"
+#include "vec_kernels.h"
 
 VM::VM(Assembler& a, SourceManager* mgr)
     : code(a.code), constants(a.constants), sm(mgr) {
+    // the destructor releases these, the assembler keeps its own references
+    for (auto v : constants) retain(v);
     stack.resize(4096);
 }
 
@@ -15,10 +18,41 @@ static inline Value from_intscaled(int64_t q) {
     return Value::make_intscaled(q);
 }
 
+static inline bool is_string(const Value &v) {
+    return v.is_obj() && v.as_obj()->type == OBJ_STRING;
+}
+
+static inline ObjList* as_list(const Value &v) {
+    return (v.is_obj() && v.as_obj()->type == OBJ_LIST) ? (ObjList*) v.as_obj() : nullptr;
+}
+
 void VM::run() {
+    OutputBuffer::Scope scope(out);
+    if (profile) {
+        profile->reset(code.size());
+        run_loop<true, false>(0, 0);
+    } else
+        run_loop<false, false>(0, 0);
+    out.flush();
+}
+
+bool VM::call_pure(int entry_pc, const std::vector<Value>& args, uint64_t max_steps, Value& result) {
+    // nothing a previous call left behind is visible to this one
+    for (Value& v : stack) { release(v); v = Value::make_nil(); }
+    for (size_t i = 0; i < args.size(); ++i) { stack[i] = args[i]; retain(stack[i]); }
+    returned = Value::make_nil();
+    if (entry_pc < 0 || !run_loop<false, true>((size_t)entry_pc, max_steps) || !frames.empty()) return false;
+    result = returned;
+    retain(result);
+    return true;
+}
+
+template<bool PROFILE, bool SANDBOX>
+bool VM::run_loop(size_t entry, uint64_t max_steps) {
     frames.clear();
     frames.push_back({-1, 0, -1});
-    ip = 0;
+    ip = entry;
+    uint64_t steps = 0;
     Instr* instructions = code.data();
     size_t code_size = code.size();
     Value* consts = constants.data();
@@ -29,6 +63,8 @@ void VM::run() {
     while (ip < code_size) {
         Instr ins = instructions[ip];
         int base = frames.back().base_reg;
+        if constexpr (PROFILE) profile->counts[ip]++;
+        if constexpr (SANDBOX) if (steps++ >= max_steps) return false;
 
         auto ensure_stack_capacity = [&](size_t needed) {
             if (needed >= stack.size()) {
@@ -56,8 +92,29 @@ void VM::run() {
                 retain(stack[dst]);
                 break;
             }
+            case OP_MOVE_OWN: {
+                // source is dead: hand its reference over instead of retaining a copy
+                int dst = base + ins.a;
+                int src = base + ins.b;
+                release(stack[dst]);
+                stack[dst] = stack[src];
+                stack[src] = Value::make_nil();
+                break;
+            }
+            case OP_MOVE_S:
+                // neither register ever holds an object here
+                stack[base + ins.a] = stack[base + ins.b];
+                break;
 
-            case OP_ADD: {
+            // generic arithmetic yields nil for non-number operands, the _NN forms trust the compiler
+            case OP_ADD:
+                if (!stack[base + ins.b].is_num() || !stack[base + ins.c].is_num()) {
+                    release(stack[base + ins.a]);
+                    stack[base + ins.a] = Value::make_nil();
+                    break;
+                }
+                [[fallthrough]];
+            case OP_ADD_NN: {
                 int dst = base + ins.a;
                 int a = base + ins.b;
                 int b = base + ins.c;
@@ -68,7 +125,14 @@ void VM::run() {
                 stack[dst] = from_intscaled(fres);
                 break;
             }
-            case OP_SUB: {
+            case OP_SUB:
+                if (!stack[base + ins.b].is_num() || !stack[base + ins.c].is_num()) {
+                    release(stack[base + ins.a]);
+                    stack[base + ins.a] = Value::make_nil();
+                    break;
+                }
+                [[fallthrough]];
+            case OP_SUB_NN: {
                 int dst = base + ins.a;
                 int a = base + ins.b;
                 int b = base + ins.c;
@@ -79,20 +143,33 @@ void VM::run() {
                 stack[dst] = from_intscaled(fres);
                 break;
             }
-            case OP_MUL: {
+            case OP_MUL:
+                if (!stack[base + ins.b].is_num() || !stack[base + ins.c].is_num()) {
+                    release(stack[base + ins.a]);
+                    stack[base + ins.a] = Value::make_nil();
+                    break;
+                }
+                [[fallthrough]];
+            case OP_MUL_NN: {
                 int dst = base + ins.a;
                 int a = base + ins.b;
                 int b = base + ins.c;
                 int64_t fa = to_intscaled_from_value(stack[a]);
                 int64_t fb = to_intscaled_from_value(stack[b]);
                 // multiply in 128-bit to keep precision: (fa * fb) >> INTSCALED_SHIFT
-                __int128 tmp = (__int128)fa * (__int128)fb;
-                int64_t fres = (int64_t)(tmp >> INTSCALED_SHIFT);
+                int64_t fres = intscaled_mul(fa, fb);
                 release(stack[dst]);
                 stack[dst] = from_intscaled(fres);
                 break;
             }
-            case OP_DIV: {
+            case OP_DIV:
+                if (!stack[base + ins.b].is_num() || !stack[base + ins.c].is_num()) {
+                    release(stack[base + ins.a]);
+                    stack[base + ins.a] = Value::make_nil();
+                    break;
+                }
+                [[fallthrough]];
+            case OP_DIV_NN: {
                 int dst = base + ins.a;
                 int a = base + ins.b;
                 int b = base + ins.c;
@@ -103,14 +180,36 @@ void VM::run() {
                     stack[dst] = Value::make_nil();
                     break;
                 }
-                __int128 numer = (__int128)fa << INTSCALED_SHIFT;
-                int64_t fres = (int64_t)(numer / (__int128)fb);
+                int64_t fres = intscaled_div(fa, fb);
                 release(stack[dst]);
                 stack[dst] = from_intscaled(fres);
                 break;
             }
 
-            case OP_LT: {
+            case OP_DIV_POW2: {
+                // ins.c = log2 of the constant divisor (negative for fractions), truncating like OP_DIV
+                int dst = base + ins.a;
+                int64_t fa = to_intscaled_from_value(stack[base + ins.b]);
+                int64_t fres;
+                if (ins.c >= 0) {
+                    fres = fa >> ins.c;
+                    if (fa < 0 && (fa & ((INT64_C(1) << ins.c) - 1)) != 0) fres += 1;
+                } else {
+                    fres = (int64_t)((uint64_t)fa << -ins.c);
+                }
+                release(stack[dst]);
+                stack[dst] = from_intscaled(fres);
+                break;
+            }
+
+            case OP_LT:
+                if (!stack[base + ins.b].is_num() || !stack[base + ins.c].is_num()) {
+                    release(stack[base + ins.a]);
+                    stack[base + ins.a] = Value::make_nil();
+                    break;
+                }
+                [[fallthrough]];
+            case OP_LT_NN: {
                 int dst = base + ins.a;
                 int a = base + ins.b;
                 int b = base + ins.c;
@@ -120,7 +219,14 @@ void VM::run() {
                 stack[dst] = Value::make_bool(fa < fb);
                 break;
             }
-            case OP_GT: {
+            case OP_GT:
+                if (!stack[base + ins.b].is_num() || !stack[base + ins.c].is_num()) {
+                    release(stack[base + ins.a]);
+                    stack[base + ins.a] = Value::make_nil();
+                    break;
+                }
+                [[fallthrough]];
+            case OP_GT_NN: {
                 int dst = base + ins.a;
                 int a = base + ins.b;
                 int b = base + ins.c;
@@ -140,25 +246,42 @@ void VM::run() {
                 break;
             }
 
-            case OP_CALL: {
+            case OP_CALL_MEMO: {
+                auto& cache = memo_caches[ins.b];
+                if (!cache) cache = std::make_unique<MemoCache>(memo_capacity);
+                if (const Value* hit = cache->lookup(&stack[base + ins.a + 1], ins.c)) {
+                    release(stack[base + ins.a]);
+                    stack[base + ins.a] = *hit;
+                    retain(stack[base + ins.a]);
+                    break;
+                }
+                [[fallthrough]];
+            }
+            case OP_CALL:
+            case OP_CALL_OWN: {
                 int dest_rel = ins.a;
                 int target_pc = ins.b;
                 int argc = ins.c;
 
                 int caller_base = frames.back().base_reg;
                 int dest_abs = caller_base + dest_rel;
+                if constexpr (SANDBOX) if (frames.size() >= SANDBOX_MAX_DEPTH) return false;
 
                 int new_base = caller_base + FRAME_SIZE;
                 ensure_stack_capacity(new_base + std::max(argc, FRAME_SIZE) + 8);
 
                 for (int i = 0; i < argc; i++) {
-                    Value v = stack[caller_base + dest_rel + 1 + i];
+                    Value& arg = stack[caller_base + dest_rel + 1 + i];
                     release(stack[new_base + i]);
-                    stack[new_base + i] = v;
-                    retain(stack[new_base + i]);
+                    stack[new_base + i] = arg;
+                    // OP_CALL_OWN: the argument registers die at the call, move them into the callee
+                    if (ins.op == OP_CALL_OWN) arg = Value::make_nil();
+                    else retain(stack[new_base + i]);
                 }
 
-                frames.push_back({ (int)ip + 1, new_base, dest_abs });
+                frames.push_back({ (int)ip + 1, new_base, dest_abs,
+                                   ins.op == OP_CALL_MEMO ? memo_caches[target_pc].get() : nullptr });
+                if constexpr (PROFILE) if (target_pc >= 0 && target_pc < (int)code_size) profile->calls[target_pc]++;
                 ip = target_pc;
                 continue;
             }
@@ -178,6 +301,7 @@ void VM::run() {
                 ensure_stack_capacity(arg0_abs + argc);
 
                 Value fv = stack[func_abs];
+                if constexpr (PROFILE) profile->types[ip] |= observed_type_bit(fv);
                 if (!fv.is_obj() || fv.as_obj()->type != OBJ_FUNCTION) {
                     release(stack[dest_abs]);
                     stack[dest_abs] = Value::make_nil();
@@ -187,6 +311,7 @@ void VM::run() {
 
                 if (of->builtin_id >= 0) {
                     const BuiltinEntry* be = BuiltinRegistry::get_entry(of->builtin_id);
+                    if constexpr (SANDBOX) if (!be || !be->pure) return false;
                     if (!be || !be->fn) {
                         release(stack[dest_abs]);
                         stack[dest_abs] = Value::make_nil();
@@ -195,8 +320,7 @@ void VM::run() {
                     const Value* args = (argc > 0) ? &stack[arg0_abs] : nullptr;
                     Value result = be->fn(argc, args, be->ctx);
                     release(stack[dest_abs]);
-                    stack[dest_abs] = result;
-                    retain(stack[dest_abs]);
+                    stack[dest_abs] = result;   // already owned, see BuiltinFn
                     break;
                 } else {
                     release(stack[dest_abs]);
@@ -210,9 +334,19 @@ void VM::run() {
                 bool cond_false = false;
                 if (v.is_bool()) cond_false = !v.as_bool();
                 else cond_false = v.is_nil();
+                if constexpr (PROFILE) (cond_false ? profile->cond_false : profile->cond_true)[ip]++;
                 if (cond_false) { ip = ins.b; continue; }
                 break;
             }
+            case OP_JMP_TRUE: {
+                Value v = stack[base + ins.a];
+                bool cond_false = false;
+                if (v.is_bool()) cond_false = !v.as_bool();
+                else cond_false = v.is_nil();
+                if constexpr (PROFILE) (cond_false ? profile->cond_false : profile->cond_true)[ip]++;
+                if (!cond_false) { ip = ins.b; continue; }
+                break;
+            }
             case OP_JMP:
                 ip = ins.b;
                 continue;
@@ -223,11 +357,14 @@ void VM::run() {
                 Value retv = stack[callee_base + src_rel];
                 CallFrame fr = frames.back();
                 frames.pop_back();
-                if (frames.empty()) return;
+                if (frames.empty()) { returned = retv; return true; }
                 int ret_dst = fr.ret_slot;
+                // the arguments are still in the caller's registers after the result slot
+                if (fr.memo) fr.memo->insert(&stack[ret_dst + 1], instructions[fr.return_addr - 1].c, retv);
+                // the callee frame is dead, so its reference moves to the caller
                 release(stack[ret_dst]);
                 stack[ret_dst] = retv;
-                retain(stack[ret_dst]);
+                stack[callee_base + src_rel] = Value::make_nil();
                 ip = fr.return_addr;
                 continue;
             }
@@ -291,6 +428,7 @@ void VM::run() {
 
                 Value tblv = stack[tbl_reg];
                 Value result = Value::make_nil();
+                if constexpr (PROFILE) profile->types[ip] |= observed_type_bit(tblv) | observed_type_bit(stack[key_reg]) << 16;
                 if (tblv.is_obj() && tblv.as_obj()->type == OBJ_TABLE) {
                     ObjTable* tbl = (ObjTable*)tblv.as_obj();
                     Value key = stack[key_reg];
@@ -344,21 +482,21 @@ void VM::run() {
 
             case OP_LIST_GET: {
                 // ins.a = dest_rel, ins.b = list_reg, ins.c = index_reg
+                Value listv = stack[base + ins.b];
+                if (!listv.is_obj() || listv.as_obj()->type != OBJ_LIST || !stack[base + ins.c].is_num()) {
+                    release(stack[base + ins.a]);
+                    stack[base + ins.a] = Value::make_nil();
+                    break;
+                }
+                [[fallthrough]];
+            }
+            case OP_LIST_GET_L: {
+                // list and number index proven by the compiler, only the bounds are checked
                 int dst = base + ins.a;
-                int list_reg = base + ins.b;
-                int idx_reg = base + ins.c;
-                Value listv = stack[list_reg];
+                ObjList* L = (ObjList*) stack[base + ins.b].as_obj();
+                int64_t idx = stack[base + ins.c].as_intscaled() >> INTSCALED_SHIFT;
                 Value result = Value::make_nil();
-                if (listv.is_obj() && listv.as_obj()->type == OBJ_LIST) {
-                    ObjList* L = (ObjList*) listv.as_obj();
-                    if (stack[idx_reg].is_num()) {
-                        int64_t idx = stack[idx_reg].as_intscaled() >> INTSCALED_SHIFT;
-                        if (idx >= 0 && (size_t)idx < L->elements.size()) result = L->elements[(size_t)idx];
-                        else result = Value::make_nil();
-                    } else {
-                        result = Value::make_nil();
-                    }
-                } else result = Value::make_nil();
+                if (idx >= 0 && (size_t)idx < L->elements.size()) result = L->elements[(size_t)idx];
 
                 release(stack[dst]);
                 stack[dst] = result;
@@ -461,29 +599,116 @@ void VM::run() {
 
             case OP_STRUCT_GET: {
                 // ins.a = dest_rel, ins.b = struct_reg (relative), ins.c = field_index
+                Value structv = stack[base + ins.b];
+                if (!structv.is_obj() || structv.as_obj()->type != OBJ_STRUCT ||
+                    ins.c < 0 || ins.c >= (int)((ObjStruct*) structv.as_obj())->fields.size()) {
+                    release(stack[base + ins.a]);
+                    stack[base + ins.a] = Value::make_nil();
+                    break;
+                }
+                [[fallthrough]];
+            }
+            case OP_FIELD_GET_ITEM: {
+                // item with at least ins.c + 1 fields proven by the compiler
                 int dst = base + ins.a;
-                int struct_reg = base + ins.b;
-                int field_index = ins.c;
-                Value structv = stack[struct_reg];
-                Value result = Value::make_nil();
-                if (structv.is_obj() && structv.as_obj()->type == OBJ_STRUCT) {
-                    ObjStruct* os = (ObjStruct*) structv.as_obj();
-                    if (field_index >= 0 && field_index < (int)os->fields.size()) result = os->fields[field_index];
-                    else result = Value::make_nil();
-                } else
-                    result = Value::make_nil();
-                
+                Value result = ((ObjStruct*) stack[base + ins.b].as_obj())->fields[ins.c];
+
                 release(stack[dst]);
                 stack[dst] = result;
                 retain(stack[dst]);
                 break;
             }
 
+            case OP_CONCAT: {
+                // ins.a = dest_rel, ins.b / ins.c = the two strings, nil when either is something else
+                int dst = base + ins.a;
+                Value l = stack[base + ins.b], r = stack[base + ins.c];
+                if (!is_string(l) || !is_string(r)) {
+                    release(stack[dst]);
+                    stack[dst] = Value::make_nil();
+                    break;
+                }
+                ObjString* ls = (ObjString*) l.as_obj();
+                std::string_view rs = ((ObjString*) r.as_obj())->view();
+                // "s = s + x" with no other reference to s: append in place, growth amortized by std::string
+                if (ins.a == ins.b && ls->refcount == 1 && ls->owns_chars()) {
+                    ls->str += rs;
+                    break;
+                }
+                std::string_view lv = ls->view();
+                std::string joined;
+                joined.reserve(lv.size() + rs.size());
+                joined += lv;
+                joined += rs;
+                Value v = Value::make_obj(new ObjString(std::move(joined)));
+                release(stack[dst]);
+                stack[dst] = v;   // the only reference, see above
+                break;
+            }
+
+            case OP_CONCAT_N: {
+                // ins.a = dest_rel, ins.c = count of strings in a+1 .. a+c, joined with one allocation
+                int dst = base + ins.a;
+                size_t total = 0;
+                bool ok = true;
+                for (int i = 1; i <= ins.c && ok; ++i) {
+                    ok = is_string(stack[dst + i]);
+                    if (ok) total += ((ObjString*) stack[dst + i].as_obj())->view().size();
+                }
+                Value v = Value::make_nil();
+                if (ok) {
+                    std::string joined;
+                    joined.reserve(total);
+                    for (int i = 1; i <= ins.c; ++i) joined += ((ObjString*) stack[dst + i].as_obj())->view();
+                    v = Value::make_obj(new ObjString(std::move(joined)));
+                }
+                release(stack[dst]);
+                stack[dst] = v;
+                break;
+            }
+
+            case OP_VEC_ADD: case OP_VEC_SUB: case OP_VEC_MUL: case OP_VEC_DIV: {
+                // ins.a = dest_rel, ins.b / ins.c = lists or numbers, at least one a list; two lists
+                // pair up as far as the shorter goes. Anything else gives an empty list.
+                int dst = base + ins.a;
+                Value l = stack[base + ins.b], r = stack[base + ins.c];
+                ObjList* ll = as_list(l);
+                ObjList* rl = as_list(r);
+                size_t n = (ll && rl) ? std::min(ll->elements.size(), rl->elements.size())
+                         : ll ? ll->elements.size() : rl ? rl->elements.size() : 0;
+                const Value* lv = ll ? ll->elements.data() : &stack[base + ins.b];
+                const Value* rv = rl ? rl->elements.data() : &stack[base + ins.c];
+                VecOp op = (VecOp)(ins.op - OP_VEC_ADD);
+                // "l = l * x" with no other reference to l: overwrite its elements
+                ObjList* self = (ins.a == ins.b) ? ll : (ins.a == ins.c) ? rl : nullptr;
+                if (self && self->refcount == 1 && self->elements.size() == n) {
+                    vec_arith(op, lv, !ll, rv, !rl, self->elements.data(), n, true);
+                    break;
+                }
+                ObjList* out = new ObjList();
+                out->elements.assign(n, Value::make_nil());
+                vec_arith(op, lv, !ll, rv, !rl, out->elements.data(), n, false);
+                release(stack[dst]);
+                stack[dst] = Value::make_obj(out);   // the only reference, see above
+                break;
+            }
+
             default:
                 break;
         }
         ip++;
     }
+    return true;
+}
+
+MemoCache::Stats VM::memo_stats() const {
+    MemoCache::Stats total;
+    for (const auto& [pc, cache] : memo_caches) {
+        total.hits += cache->stats().hits;
+        total.misses += cache->stats().misses;
+        total.evictions += cache->stats().evictions;
+    }
+    return total;
 }
 
 VM::~VM() {
@@ -1,11 +1,17 @@
 #pragma once
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include "value.h"
 #include "assembler.h"
 #include "source_manager.h"
+#include "profile.h"
+#include "memo_cache.h"
+#include "output.h"
 
 struct CallFrame {
     int return_addr; int base_reg; int ret_slot;
+    MemoCache* memo = nullptr;   // OP_CALL_MEMO that missed: the result goes here too
 };
 
 struct VM {
@@ -15,8 +21,30 @@ struct VM {
     std::vector<Value> constants;
     SourceManager* sm = nullptr;
     size_t ip = 0;
+    // filled by run() when set (--profile-out), sized to the code
+    ProfileCounters* profile = nullptr;
+    // entries each memo function keeps (MONDOT_MEMO_CAPACITY)
+    size_t memo_capacity = 1024;
+    // what print writes while this VM runs
+    OutputBuffer out;
 
     VM(Assembler& a, SourceManager* mgr = nullptr);
     void run();
+    // compile-time evaluation: runs the function at entry_pc on args and hands back a
+    // reference to what it returns. Fails on builtins that are not pure, past max_steps
+    // instructions and past SANDBOX_MAX_DEPTH nested calls.
+    bool call_pure(int entry_pc, const std::vector<Value>& args, uint64_t max_steps, Value& result);
     ~VM();
+
+    // OP_CALL_MEMO counters summed over every memo function
+    MemoCache::Stats memo_stats() const;
+
+    static constexpr size_t SANDBOX_MAX_DEPTH = 64;
+
+private:
+    // what the outermost frame returned
+    Value returned = Value::make_nil();
+    std::unordered_map<int, std::unique_ptr<MemoCache>> memo_caches;   // by function entry pc
+
+    template<bool PROFILE, bool SANDBOX> bool run_loop(size_t entry, uint64_t max_steps);
 };